@@ -0,0 +1,189 @@
+/*
+MIT License
+
+Copyright (c) 2025 broskobandi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/** @file src/alloc_tracker.hpp
+ * @brief Private header file for the AllocTracker class.
+ * @details This file contains the definition of the AllocTracker class which
+ * counts heap allocations per frame phase. Counting is opt-in: the global
+ * operator new and delete are only replaced if TRACK_ALLOCS is defined,
+ * which must happen in exactly one translation unit of the program. */
+
+#ifndef ALLOC_TRACKER_HPP
+#define ALLOC_TRACKER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+
+class AllocTracker {
+public:
+
+	/** The phases of a frame the allocations are attributed to. */
+	enum class Phase : std::size_t {
+		Other,
+		Events,
+		Update,
+		RenderData,
+		Draw,
+		Count
+	};
+
+	/** RAII helper that attributes the allocations made during its
+	 * lifetime on the current thread to the given phase. */
+	class Scope {
+		Phase prev;
+	public:
+		Scope(Phase phase) : prev(cur_phase) {
+			cur_phase = phase;
+		}
+		~Scope() {
+			cur_phase = prev;
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+
+private:
+
+	static constexpr std::size_t phase_count {static_cast<std::size_t>(Phase::Count)};
+
+	// Private variables.
+
+	static inline thread_local Phase cur_phase {Phase::Other};
+	static inline std::array<std::atomic<std::size_t>, phase_count> allocs {};
+	static inline std::array<std::atomic<std::size_t>, phase_count> bytes {};
+
+public:
+
+	/** Returns whether the allocation hook is compiled in. */
+	static constexpr bool enabled() {
+#ifdef TRACK_ALLOCS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/** Records a single allocation. Called by the allocation hook.
+	 * @param size The size of the allocation in bytes. */
+	static void record(std::size_t size) {
+		auto i = static_cast<std::size_t>(cur_phase);
+		allocs[i].fetch_add(1, std::memory_order_relaxed);
+		bytes[i].fetch_add(size, std::memory_order_relaxed);
+	}
+
+	/** Resets every counter to zero. */
+	static void reset() {
+		for (std::size_t i = 0; i < phase_count; i++) {
+			allocs[i].store(0, std::memory_order_relaxed);
+			bytes[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	/** Returns the number of allocations made during the given phase. */
+	static std::size_t count(Phase phase) {
+		return allocs[static_cast<std::size_t>(phase)].load(std::memory_order_relaxed);
+	}
+
+	/** Returns the number of bytes allocated during the given phase. */
+	static std::size_t size(Phase phase) {
+		return bytes[static_cast<std::size_t>(phase)].load(std::memory_order_relaxed);
+	}
+
+	/** Returns the number of allocations made during all the phases. */
+	static std::size_t total() {
+		std::size_t n = 0;
+		for (std::size_t i = 0; i < phase_count; i++)
+			n += allocs[i].load(std::memory_order_relaxed);
+		return n;
+	}
+
+	/** Writes the counters of every phase into the given stream.
+	 * @param os The stream to write into. */
+	static void report(std::ostream& os) {
+		static constexpr const char* names[phase_count] {
+			"other", "events", "update", "render_data", "draw"
+		};
+		for (std::size_t i = 0; i < phase_count; i++) {
+			os << names[i] << ": " << count(static_cast<Phase>(i)) << " allocs, "
+				<< size(static_cast<Phase>(i)) << " bytes\n";
+		}
+	}
+};
+
+#ifdef TRACK_ALLOCS
+
+// The replacements are kept out of line so the compiler does not pair
+// the inlined std::free with an unrelated operator new at the call site.
+
+[[gnu::noinline]] void* operator new(std::size_t size) {
+	AllocTracker::record(size);
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+[[gnu::noinline]] void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	AllocTracker::record(size);
+	return std::malloc(size ? size : 1);
+}
+
+[[gnu::noinline]] void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+	return operator new(size, tag);
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+[[gnu::noinline]] void operator delete[](void* p) noexcept {
+	std::free(p);
+}
+
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+[[gnu::noinline]] void operator delete[](void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+[[gnu::noinline]] void operator delete(void* p, const std::nothrow_t&) noexcept {
+	std::free(p);
+}
+
+[[gnu::noinline]] void operator delete[](void* p, const std::nothrow_t&) noexcept {
+	std::free(p);
+}
+
+#endif
+
+#endif
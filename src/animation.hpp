@@ -0,0 +1,156 @@
+/*
+MIT License
+
+Copyright (c) 2025 broskobandi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/** @file src/animation.hpp
+ * @brief Private header file for the Animation struct and the Animations class.
+ * @details This file contains the definition of the Animations class which is
+ * responsible for storing frame sequences and advancing all of them along
+ * one shared timeline. */
+
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+#include "core.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace Core;
+
+/** POD struct that describes a single frame sequence. */
+struct Animation {
+	/** Paths to the bmps of the frames in playback order. */
+	std::vector<std::string> paths_to_bmps;
+	/** The duration of each frame in milliseconds. */
+	std::vector<Uint32> frame_durations;
+};
+
+class Animations {
+private:
+
+	/** An animation together with its playback state. */
+	struct Entry {
+		/** The frame sequence. */
+		Animation animation;
+		/** The length of one loop in milliseconds. */
+		Uint32 total_duration {0};
+		/** Index of the frame that is visible at the current time. */
+		std::size_t cur_frame {0};
+	};
+
+	// Private variables.
+
+	std::map<std::string, Entry, std::less<>> entries;
+	/** The time of the last tick. */
+	Uint32 last_ticks {0};
+	/** The earliest time at which any animation shows a new frame. */
+	Uint64 next_boundary {0};
+
+public:
+
+	/** Registers a new animation.
+	 * @param name The name the animation can be referred to by.
+	 * @param animation The frame sequence.
+	 * @throws std::runtime_error if the animation is invalid or
+	 * the name is already taken. */
+	void add(const std::string& name, Animation animation) {
+		if (animation.paths_to_bmps.empty())
+			throw std::runtime_error("Animation has no frames.");
+		if (animation.paths_to_bmps.size() != animation.frame_durations.size())
+			throw std::runtime_error("Animation frame and duration count mismatch.");
+		Entry entry;
+		for (auto d : animation.frame_durations) {
+			if (!d)
+				throw std::runtime_error("Animation frame duration is zero.");
+			entry.total_duration += d;
+		}
+		entry.animation = std::move(animation);
+		if (!entries.emplace(name, std::move(entry)).second)
+			throw std::runtime_error("Failed to emplace new animation into map.");
+		DBGMSG("New animation emplaced into map: " << name);
+	}
+
+	/** Checks whether an animation is registered under the given name.
+	 * @param name The name to look for. */
+	bool contains(std::string_view name) const {
+		return entries.find(name) != entries.end();
+	}
+
+	/** Advances every animation to the frame visible at the given time.
+	 * Until the next frame boundary this returns immediately; otherwise the
+	 * cost is proportional to the number of animations, not to the number
+	 * of tiles that use them.
+	 * @param ticks The current time in milliseconds.
+	 * @return true if any animation shows a different frame than before. */
+	bool tick(Uint32 ticks) {
+		if (ticks >= last_ticks && ticks < next_boundary) {
+			last_ticks = ticks;
+			return false;
+		}
+		bool changed = false;
+		Uint64 until = UINT32_MAX;
+		for (auto& [name, e] : entries) {
+			Uint32 t = ticks % e.total_duration;
+			std::size_t i = 0;
+			while (t >= e.animation.frame_durations[i]) {
+				t -= e.animation.frame_durations[i];
+				i++;
+			}
+			if (e.cur_frame != i)
+				changed = true;
+			e.cur_frame = i;
+			until = std::min<Uint64>(until, e.animation.frame_durations[i] - t);
+		}
+		last_ticks = ticks;
+		next_boundary = ticks + until;
+		return changed;
+	}
+
+	/** Returns the path to the bmp of the currently visible frame.
+	 * The view stays valid for the lifetime of the Animations object.
+	 * @param name The name of the animation.
+	 * @throws std::runtime_error if there is no such animation. */
+	std::string_view current_frame(std::string_view name) const {
+		auto e = entries.find(name);
+		if (e == entries.end())
+			throw std::runtime_error("Failed to find animation.");
+		return e->second.animation.paths_to_bmps[e->second.cur_frame];
+	}
+
+	/** Returns a vector of the paths to all the frames of all the animations. */
+	auto get_paths_to_bmps() const {
+		std::vector<std::string> paths;
+		for (const auto& [name, e] : entries) {
+			for (const auto& p : e.animation.paths_to_bmps)
+				paths.push_back(p);
+		}
+		return paths;
+	}
+};
+
+#endif
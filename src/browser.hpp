@@ -32,8 +32,14 @@ SOFTWARE.
 #define BROWSER_HPP
 
 #include "core.hpp"
+#include "animation.hpp"
+#include "pack.hpp"
+#include "search.hpp"
+#include <algorithm>
 #include <cstdlib>
+#include <map>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 #include <filesystem>
@@ -48,8 +54,10 @@ private:
 	struct Thumbnail {
 		/** The rect to render the thumbnail over. */
 		SDL_Rect rect;
-		/** Path to the bmp to be rendered over the thumbnail. */
+		/** Path to the bmp (or the name of the animation) the thumbnail selects. */
 		std::string path_to_bmp;
+		/** Path to the bmp to be rendered over the thumbnail. */
+		std::string path_to_preview;
 	};
 
 	// Private variables.
@@ -58,11 +66,73 @@ private:
 	SDL_Color panel_col;
 	SDL_Rect panel;
 	std::vector<Thumbnail> thumbnails;
+	SearchIndex search_index;
+	/** The range of the search results that is on screen. */
+	std::size_t first_shown {0}, last_shown {0};
 	int thumbnails_offset {0};
-	std::string selected_bmp;
+	std::string_view selected_bmp;
+	Animations animations;
+	std::vector<RenderData> data;
+
+	/** The duration of each frame of the animations found in the working directory. */
+	static constexpr Uint32 frame_duration {100};
 
 	// Private methods
 
+	/** Adds a thumbnail for a single bmp.
+	 * @param path_to_bmp The path to the bmp. */
+	void add_bmp(const std::string& path_to_bmp) {
+		Thumbnail t;
+		t.path_to_bmp = path_to_bmp;
+		t.path_to_preview = path_to_bmp;
+		t.rect = {0, 0, 0, 0};
+		thumbnails.push_back(t);
+	}
+
+	/** Creates an animation out of the given frames and adds a thumbnail
+	 * for it. The frames are played in file name order.
+	 * @param name The name of the animation (the path of its directory).
+	 * @param paths_to_bmps The paths to the frames. */
+	void add_animation(const std::string& name, std::vector<std::string> paths_to_bmps) {
+		if (paths_to_bmps.empty())
+			return;
+		Animation animation;
+		animation.paths_to_bmps = std::move(paths_to_bmps);
+		std::sort(animation.paths_to_bmps.begin(), animation.paths_to_bmps.end());
+		animation.frame_durations.assign(animation.paths_to_bmps.size(), frame_duration);
+		Thumbnail t;
+		t.path_to_bmp = name;
+		t.path_to_preview = animation.paths_to_bmps.front();
+		t.rect = {0, 0, 0, 0};
+		animations.add(t.path_to_bmp, std::move(animation));
+		thumbnails.push_back(t);
+	}
+
+	/** Creates an animation out of the bmp files found in a subdirectory.
+	 * @param path The path of the subdirectory. */
+	void add_animation(const std::filesystem::path& path) {
+		std::vector<std::string> paths_to_bmps;
+		for (const auto& entry : std::filesystem::directory_iterator(path)) {
+			if (entry.path().extension() == ".bmp")
+				paths_to_bmps.push_back(entry.path().string());
+		}
+		add_animation(path.string(), std::move(paths_to_bmps));
+	}
+
+	/** Indexes the names of the thumbnails relative to the working directory.
+	 * @param root The path of the working directory. */
+	void build_search_index(const std::string& root) {
+		std::vector<std::string> names;
+		for (const auto& t : thumbnails) {
+			if (t.path_to_bmp.compare(0, root.size(), root) == 0) {
+				names.push_back(t.path_to_bmp.substr(root.size()));
+			} else {
+				names.push_back(t.path_to_bmp);
+			}
+		}
+		search_index = SearchIndex(names);
+	}
+
 	/** Sets the panel size based on the window size and the panel_width_multiplier.
 	 * @param win_size The current size of the window. */
 	void set_panel_size(std::pair<int, int> win_size) {
@@ -72,18 +142,27 @@ private:
 		panel.y = 0;
 	}
 
-	/** Sets the size of the thumbnails based on the panel size.
+	/** Sets the size of the thumbnails based on the panel size. Only the
+	 * search results that are on screen are laid out.
 	 * @throws std::runtime_error if there are no thumbnails available. */
 	void set_thumbnails_size() {
 		if (!thumbnails.size())
 			throw std::runtime_error("Thumbnails vector is empty.");
-		int i = 0;
-		for (auto& t : thumbnails) {
+		const auto& results = search_index.get_results();
+		first_shown = 0;
+		last_shown = 0;
+		if (panel.w <= 0)
+			return;
+		int first = std::max(0, -thumbnails_offset / panel.w);
+		first_shown = std::min(static_cast<std::size_t>(first), results.size());
+		last_shown = std::min(
+			first_shown + static_cast<std::size_t>(panel.h / panel.w + 2), results.size());
+		for (std::size_t i = first_shown; i < last_shown; i++) {
+			auto& t = thumbnails[results[i]];
 			t.rect.x = 0;
-			t.rect.y = panel.w * i + thumbnails_offset;
+			t.rect.y = panel.w * static_cast<int>(i) + thumbnails_offset;
 			t.rect.w = panel.w;
 			t.rect.h = panel.w;
-			i++;
 		}
 	}
 
@@ -91,7 +170,9 @@ private:
 	 * @param mouse_pos The current position of the mouse.
 	 * @param left_click The current state of the left mouse button. */
 	void set_thumbnail_highlight(std::pair<int,int> mouse_pos, bool left_click) {
-		for (auto& t : thumbnails) {
+		const auto& results = search_index.get_results();
+		for (std::size_t i = first_shown; i < last_shown; i++) {
+			auto& t = thumbnails[results[i]];
 			if (
 				mouse_pos.first < panel.w &&
 				mouse_pos.second < t.rect.y + t.rect.w &&
@@ -105,7 +186,7 @@ private:
 					if (t.path_to_bmp != selected_bmp) {
 						selected_bmp = t.path_to_bmp;
 					} else {
-						selected_bmp.clear();
+						selected_bmp = {};
 					}
 				}
 			}
@@ -125,11 +206,12 @@ public:
 		std::pair<int,int> mouse_pos,
 		bool left_click
 	) {
+		int count = static_cast<int>(search_index.get_results().size());
 		if (mouse_pos.first < panel.w)
 			thumbnails_offset += scroll_state;
-		if (thumbnails.front().rect.y > 0)
+		if (thumbnails_offset > 0)
 			thumbnails_offset -= 5;
-		if (thumbnails.back().rect.y < panel.h - panel.w)
+		if (count && panel.w * (count - 1) + thumbnails_offset < panel.h - panel.w)
 			thumbnails_offset += 5;
 		if (std::abs(thumbnails_offset) <= 5)
 			thumbnails_offset = 0;
@@ -138,6 +220,17 @@ public:
 		set_thumbnail_highlight(mouse_pos, left_click);
 	}
 
+	/** Filters the thumbnails by a search query. Every word of the query has to
+	 * prefix a word of a bmp's (or animation's) name or of its directories.
+	 * Typing more narrows the previous results instead of searching again.
+	 * @param query The search query (empty to show every thumbnail). */
+	void search(std::string_view query) {
+		if (search_index.search(query)) {
+			thumbnails_offset = 0;
+			set_thumbnails_size();
+		}
+	}
+
 	/** Constructor for the Browser class.
 	 * @param win_size The current size of the window.
 	 * @param panel_width_multiplier The panel's size compared to the window size.
@@ -152,35 +245,78 @@ public:
 		panel_width_multiplier(panel_width_multiplier), panel_col(panel_col)
 	{
 		set_panel_size(win_size);
+		path = Pack::normalize_root(path);
 
 		try {
 
 			std::filesystem::directory_iterator dir_iter(path);
 
 			for (const auto& entry : dir_iter) {
+				if (entry.is_directory()) {
+					add_animation(entry.path());
+					continue;
+				}
 				auto s = entry.path().string();
 				if (s.substr(s.length() - 4, 4) == ".bmp") {
 					// paths_to_bmps.push_back(s);
-					Thumbnail t;
-					t.path_to_bmp = s;
-					t.rect = {0, 0, 0, 0};
-					thumbnails.push_back(t);
+					add_bmp(s);
 					// thumbnails.push_back({0, 0, 0, 0});
 				}
 			}
 
-			DBGMSG(thumbnails.size() << " bmp files found in directory.");
+			DBGMSG(thumbnails.size() << " bmp files or animations found in directory.");
 
 		} catch (const std::filesystem::filesystem_error&) {
 			throw std::runtime_error("Invalid path.");
 		}
 
+		build_search_index(path.string());
+
+		set_thumbnails_size();
+	}
+
+	/** Constructor for the Browser class that lists the bmps of a pack file
+	 * instead of walking a directory. Bmps in subdirectories of the packed
+	 * directory become animations, just like in the directory constructor.
+	 * @param win_size The current size of the window.
+	 * @param panel_width_multiplier The panel's size compared to the window size.
+	 * @param panel_col The panel's background color.
+	 * @param pack The pack file to list. */
+	Browser(
+		std::pair<int, int> win_size,
+		float panel_width_multiplier,
+		SDL_Color panel_col,
+		const Pack& pack
+	) :
+		panel_width_multiplier(panel_width_multiplier), panel_col(panel_col)
+	{
+		set_panel_size(win_size);
+
+		auto root = Pack::normalize_root(pack.get_root());
+		std::map<std::string, std::vector<std::string>> frames;
+		for (const auto& e : pack.entries()) {
+			std::filesystem::path path(e.name);
+			if (Pack::normalize_root(path.parent_path()) == root) {
+				add_bmp(std::string(e.name));
+			} else {
+				frames[path.parent_path().string()].emplace_back(e.name);
+			}
+		}
+		for (auto& [name, paths_to_bmps] : frames) {
+			add_animation(name, std::move(paths_to_bmps));
+		}
+
+		DBGMSG(thumbnails.size() << " bmp files or animations found in pack.");
+
+		build_search_index(root.string());
+
 		set_thumbnails_size();
 	}
 
-	/** Creates and returns the most up-to-date rendering context. */
-	auto render_data() {
-		std::vector<RenderData> data;
+	/** Creates and returns the most up-to-date rendering context.
+	 * The returned vector is reused by the next call. */
+	const std::vector<RenderData>& render_data() {
+		data.clear();
 		
 		// Panel
 		
@@ -189,9 +325,11 @@ public:
 		panel_data.col_or_path_to_tex = panel_col;
 		data.push_back(panel_data);
 
-		// Thumbnails
+		// Thumbnails (only the search results that are on screen)
 
-		for (const auto& t : thumbnails) {
+		const auto& results = search_index.get_results();
+		for (std::size_t i = first_shown; i < last_shown; i++) {
+			const auto& t = thumbnails[results[i]];
 			RenderData thumbnail;
 			SDL_Rect rect = t.rect;
 			if (t.path_to_bmp == selected_bmp) {
@@ -201,15 +339,16 @@ public:
 				rect.y += rect.w / 20;
 			}
 			thumbnail.dstrect = rect;
-			thumbnail.col_or_path_to_tex = t.path_to_bmp;
+			thumbnail.col_or_path_to_tex = t.path_to_preview;
 			data.push_back(thumbnail);
 		}
 
 		return data;
 	}
 
-	/** Returns the path of the currently selected bmp. */
-	std::string get_selected_bmp() {
+	/** Returns the path of the currently selected bmp (or the name of the animation).
+	 * The view stays valid for the lifetime of the Browser. */
+	std::string_view get_selected_bmp() {
 		return selected_bmp;
 	}
 
@@ -218,14 +357,24 @@ public:
 		return panel.w;
 	}
 
-	/** Returns a vector of the paths to all the bmp files found in the working directory. */
+	/** Returns a vector of the paths to all the bmp files found in the working directory
+	 * including the frames of the animations. */
 	auto get_paths_to_bmps() {
 		std::vector<std::string> paths;
 		for (const auto& t: thumbnails) {
-			paths.push_back(t.path_to_bmp);
+			if (!animations.contains(t.path_to_bmp))
+				paths.push_back(t.path_to_bmp);
+		}
+		for (auto& p : animations.get_paths_to_bmps()) {
+			paths.push_back(std::move(p));
 		}
 		return paths;
 	}
+
+	/** Returns the animations found in the subdirectories of the working directory. */
+	const Animations& get_animations() {
+		return animations;
+	}
 };
 
 #endif
@@ -0,0 +1,411 @@
+/*
+MIT License
+
+Copyright (c) 2025 broskobandi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/** @file src/compositor.hpp
+ * @brief Private header file for the Compositor class.
+ * @details This file contains the definition of the Compositor class which
+ * is responsible for flattening a tile map into a single bmp on the CPU,
+ * without a renderer. Every distinct (bmp, rotation, flip) combination is
+ * scaled and transformed once, then the image is composited in bands of one
+ * tile row on every core, straight into the memory mapped output file. */
+
+#ifndef COMPOSITOR_HPP
+#define COMPOSITOR_HPP
+
+#include "core.hpp"
+#include "tile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace Core;
+
+class Compositor {
+private:
+
+	/** An image converted to ARGB8888. */
+	struct Image {
+		int w, h;
+		std::vector<Uint32> pixels;
+	};
+
+	/** A tile_size x tile_size image scaled, flipped and rotated like a tile. */
+	struct Prepared {
+		std::vector<Uint32> pixels;
+		/** Whether every pixel is opaque, so rows can be copied instead of blended. */
+		bool opaque;
+	};
+
+	/** A tile placed into the map. */
+	struct Placement {
+		int row, col;
+		const Prepared* prepared;
+	};
+
+	/** The header of a bmp file with a BITMAPINFOHEADER (little endian). */
+#pragma pack(push, 1)
+	struct BmpHeader {
+		char magic[2];
+		Uint32 file_size;
+		Uint32 reserved;
+		Uint32 pixels_offset;
+		Uint32 header_size;
+		Sint32 w, h;
+		Uint16 planes;
+		Uint16 bpp;
+		Uint32 compression;
+		Uint32 image_size;
+		Sint32 ppm_x, ppm_y;
+		Uint32 colors_used;
+		Uint32 colors_important;
+	};
+#pragma pack(pop)
+
+	// Private variables.
+
+	int cols, rows, tile_size;
+	Uint32 bg;
+	std::map<std::string_view, Image> images;
+	/** Keyed by the image, the number of clockwise quarter turns and the flip. */
+	std::map<std::tuple<const Image*, int, int>, Prepared> prepared;
+	std::vector<Placement> placements;
+
+	// Private methods.
+
+	/** Returns an image, loading it from disk if it has not been added. */
+	const Image& get_image(std::string_view name) {
+		auto it = images.find(name);
+		if (it != images.end())
+			return it->second;
+		auto sur = Surface(
+			[&](){
+				auto s = SDL_LoadBMP(std::string(name).c_str());
+				if (!s) throw std::runtime_error("Failed to load bmp.");
+				return s;
+			}(),
+			[](SDL_Surface* s) {
+				if (s) SDL_FreeSurface(s);
+			}
+		);
+		add_image(name, sur.get());
+		return images.find(name)->second;
+	}
+
+	/** Scales, flips and rotates an image the way Sdl::draw does inside a tile:
+	 * the flip is applied to the texture, then it is turned clockwise. */
+	const Prepared& prepare(const Image& image, int turns, int flip) {
+		auto k = std::make_tuple(&image, turns, flip);
+		auto it = prepared.find(k);
+		if (it != prepared.end())
+			return it->second;
+		int s = tile_size;
+		Prepared p;
+		p.pixels.resize(static_cast<std::size_t>(s * s));
+		p.opaque = true;
+		for (int y = 0; y < s; y++) {
+			for (int x = 0; x < s; x++) {
+				int u = x, v = y;
+				switch (turns) {
+					case 1: u = y; v = s - 1 - x; break;
+					case 2: u = s - 1 - x; v = s - 1 - y; break;
+					case 3: u = s - 1 - y; v = x; break;
+				}
+				if (flip & SDL_FLIP_HORIZONTAL)
+					u = s - 1 - u;
+				if (flip & SDL_FLIP_VERTICAL)
+					v = s - 1 - v;
+				Uint32 px = image.pixels[static_cast<std::size_t>(
+					v * image.h / s * image.w + u * image.w / s)];
+				p.pixels[static_cast<std::size_t>(y * s + x)] = px;
+				if ((px >> 24) != 0xff)
+					p.opaque = false;
+			}
+		}
+		return prepared.emplace(k, std::move(p)).first->second;
+	}
+
+	/** Composites one tile row into its band of the output.
+	 * @param first The first placement of the row.
+	 * @param last One past the last placement of the row.
+	 * @param out The first pixel of the band. */
+	void composite_band(const Placement* first, const Placement* last, Uint32* out) const {
+		std::size_t w = static_cast<std::size_t>(cols * tile_size);
+		std::size_t s = static_cast<std::size_t>(tile_size);
+		for (std::size_t y = 0; y < s; y++) {
+			Uint32* line = out + y * w;
+			fill_row(line, bg, w);
+			for (auto p = first; p != last; p++) {
+				Uint32* dst = line + static_cast<std::size_t>(p->col) * s;
+				const Uint32* src = p->prepared->pixels.data() + y * s;
+				if (p->prepared->opaque) {
+					std::memcpy(dst, src, s * sizeof(Uint32));
+				} else {
+					blend_row(dst, src, s);
+				}
+			}
+		}
+	}
+
+public:
+
+	/** Fills a row of pixels with a single color.
+	 * @param dst The row.
+	 * @param col The ARGB8888 color.
+	 * @param n The number of pixels. */
+	static void fill_row(Uint32* dst, Uint32 col, std::size_t n) {
+		std::size_t i = 0;
+#ifdef __SSE2__
+		__m128i c = _mm_set1_epi32(static_cast<int>(col));
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), c);
+#endif
+		for (; i < n; i++)
+			dst[i] = col;
+	}
+
+	/** Blends a row of ARGB8888 pixels over another one (source over) without SIMD.
+	 * @param dst The row blended into.
+	 * @param src The row to blend.
+	 * @param n The number of pixels. */
+	static void blend_row_scalar(Uint32* dst, const Uint32* src, std::size_t n) {
+		for (std::size_t i = 0; i < n; i++) {
+			Uint32 a = src[i] >> 24;
+			Uint32 s = src[i] | 0xff000000u;
+			Uint32 out = 0;
+			for (int shift = 0; shift < 32; shift += 8) {
+				Uint32 x = ((s >> shift) & 0xff) * a + ((dst[i] >> shift) & 0xff) * (255 - a) + 128;
+				out |= (((x + (x >> 8)) >> 8) & 0xff) << shift;
+			}
+			dst[i] = out;
+		}
+	}
+
+	/** Blends a row of ARGB8888 pixels over another one (source over).
+	 * Four pixels are blended at a time with SSE2 where available; the
+	 * result is identical to blend_row_scalar.
+	 * @param dst The row blended into.
+	 * @param src The row to blend.
+	 * @param n The number of pixels. */
+	static void blend_row(Uint32* dst, const Uint32* src, std::size_t n) {
+		std::size_t i = 0;
+#ifdef __SSE2__
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i alpha_bits = _mm_set1_epi32(static_cast<int>(0xff000000u));
+		const __m128i full = _mm_set1_epi16(255);
+		const __m128i half = _mm_set1_epi16(128);
+		auto blend = [&](__m128i s, __m128i d, __m128i a) {
+			// (s * a + d * (255 - a) + 128) / 255 in 16 bit lanes.
+			__m128i x = _mm_add_epi16(
+				_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, _mm_sub_epi16(full, a))),
+				half
+			);
+			return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+		};
+		auto alpha = [](__m128i px) {
+			px = _mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3));
+			return _mm_shufflehi_epi16(px, _MM_SHUFFLE(3, 3, 3, 3));
+		};
+		for (; i + 4 <= n; i += 4) {
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+			__m128i s_lo = _mm_unpacklo_epi8(s, zero);
+			__m128i s_hi = _mm_unpackhi_epi8(s, zero);
+			__m128i opaque = _mm_or_si128(s, alpha_bits);
+			__m128i lo = blend(_mm_unpacklo_epi8(opaque, zero), _mm_unpacklo_epi8(d, zero), alpha(s_lo));
+			__m128i hi = blend(_mm_unpackhi_epi8(opaque, zero), _mm_unpackhi_epi8(d, zero), alpha(s_hi));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+		}
+#endif
+		blend_row_scalar(dst + i, src + i, n - i);
+	}
+
+	/** Constructor for the Compositor class.
+	 * @param cols The number of columns of the map.
+	 * @param rows The number of rows of the map.
+	 * @param tile_size The size of a tile in the output in pixels.
+	 * @param bg_col The color of the empty tiles.
+	 * @throws std::runtime_error if the dimensions are invalid. */
+	Compositor(int cols, int rows, int tile_size, SDL_Color bg_col) :
+		cols(cols), rows(rows), tile_size(tile_size),
+		bg(
+			static_cast<Uint32>(bg_col.a) << 24 | static_cast<Uint32>(bg_col.r) << 16 |
+			static_cast<Uint32>(bg_col.g) << 8 | static_cast<Uint32>(bg_col.b)
+		)
+	{
+		if (cols <= 0 || rows <= 0 || tile_size <= 0)
+			throw std::runtime_error("Invalid map dimensions.");
+	}
+
+	/** Adds an image under a name so it is not loaded from disk
+	 * (e.g. a surface of a pack). The pixels are copied.
+	 * @param name The path of the bmp as it appears in the tiles.
+	 * @param sur The surface of the image.
+	 * @throws std::runtime_error on failure. */
+	void add_image(std::string_view name, SDL_Surface* sur) {
+		name = intern(name);
+		if (images.count(name))
+			return;
+		auto converted = Surface(
+			[&](){
+				auto s = SDL_ConvertSurfaceFormat(sur, SDL_PIXELFORMAT_ARGB8888, 0);
+				if (!s) throw std::runtime_error("Failed to convert surface.");
+				return s;
+			}(),
+			[](SDL_Surface* s) {
+				if (s) SDL_FreeSurface(s);
+			}
+		);
+		Image image;
+		image.w = converted->w;
+		image.h = converted->h;
+		if (image.w <= 0 || image.h <= 0)
+			throw std::runtime_error("Empty image.");
+		image.pixels.resize(static_cast<std::size_t>(image.w * image.h));
+		if (SDL_LockSurface(converted.get()))
+			throw std::runtime_error("Failed to lock surface.");
+		for (int y = 0; y < image.h; y++) {
+			std::memcpy(
+				image.pixels.data() + y * image.w,
+				static_cast<const char*>(converted->pixels) + y * converted->pitch,
+				static_cast<std::size_t>(image.w) * sizeof(Uint32)
+			);
+		}
+		SDL_UnlockSurface(converted.get());
+		images.emplace(name, std::move(image));
+	}
+
+	/** Places a tile into the map. Empty tiles are skipped. The angle is
+	 * rounded to a multiple of 90 degrees, the only angles the editor sets.
+	 * @param col The column of the tile.
+	 * @param row The row of the tile.
+	 * @param tile The tile.
+	 * @throws std::runtime_error on failure. */
+	void place(int col, int row, const Tile& tile) {
+		if (tile.path_to_bmp.empty())
+			return;
+		if (col < 0 || row < 0 || col >= cols || row >= rows)
+			throw std::runtime_error("Tile is outside the map.");
+		int turns = static_cast<int>(std::lround(tile.angle / 90.0f) % 4);
+		if (turns < 0)
+			turns += 4;
+		const auto& p = prepare(get_image(tile.path_to_bmp), turns, static_cast<int>(tile.flip));
+		placements.push_back({row, col, &p});
+	}
+
+	/** Composites the map into a 32 bit bmp file.
+	 * @param path The path of the output file.
+	 * @param threads The number of threads to use (0 for every core).
+	 * @throws std::runtime_error on failure. */
+	void save(const std::filesystem::path& path, unsigned threads = 0) {
+		Uint64 w = static_cast<Uint64>(cols) * static_cast<Uint64>(tile_size);
+		Uint64 h = static_cast<Uint64>(rows) * static_cast<Uint64>(tile_size);
+		Uint64 image_size = w * h * sizeof(Uint32);
+		Uint64 file_size = sizeof(BmpHeader) + image_size;
+		if (w > 0x7fffffff || h > 0x7fffffff || file_size > 0xffffffffu)
+			throw std::runtime_error("Map is too large for a bmp file.");
+
+		std::stable_sort(placements.begin(), placements.end(),
+			[](const Placement& a, const Placement& b){
+				return std::tie(a.row, a.col) < std::tie(b.row, b.col);
+			});
+		// Later placements of the same tile win, like set_tile.
+		auto kept = std::unique(placements.rbegin(), placements.rend(),
+			[](const Placement& a, const Placement& b){
+				return a.row == b.row && a.col == b.col;
+			});
+		placements.erase(placements.begin(), kept.base());
+
+		int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			throw std::runtime_error("Failed to open bmp file.");
+		if (ftruncate(fd, static_cast<off_t>(file_size))) {
+			close(fd);
+			throw std::runtime_error("Failed to resize bmp file.");
+		}
+		void* map = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED)
+			throw std::runtime_error("Failed to map bmp file.");
+
+		// A negative height stores the rows top-down, so bands are contiguous.
+		BmpHeader header {
+			{'B', 'M'}, static_cast<Uint32>(file_size), 0, sizeof(BmpHeader), 40,
+			static_cast<Sint32>(w), -static_cast<Sint32>(h), 1, 32, 0,
+			static_cast<Uint32>(image_size), 2835, 2835, 0, 0
+		};
+		std::memcpy(map, &header, sizeof(header));
+		Uint32* pixels = reinterpret_cast<Uint32*>(static_cast<char*>(map) + sizeof(header));
+
+		// The start of the placements of every tile row.
+		std::vector<std::size_t> row_starts(static_cast<std::size_t>(rows) + 1);
+		std::size_t i = 0;
+		for (int r = 0; r <= rows; r++) {
+			while (i < placements.size() && placements[i].row < r)
+				i++;
+			row_starts[static_cast<std::size_t>(r)] = i;
+		}
+
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = std::min(threads, static_cast<unsigned>(rows));
+		std::atomic<int> next_row {0};
+		auto work = [&](){
+			for (int r = next_row++; r < rows; r = next_row++) {
+				composite_band(
+					placements.data() + row_starts[static_cast<std::size_t>(r)],
+					placements.data() + row_starts[static_cast<std::size_t>(r) + 1],
+					pixels + static_cast<std::size_t>(r) * static_cast<std::size_t>(tile_size) * w
+				);
+			}
+		};
+		std::vector<std::thread> workers;
+		for (unsigned i = 1; i < threads; i++)
+			workers.emplace_back(work);
+		work();
+		for (auto& t : workers)
+			t.join();
+
+		bool synced = msync(map, file_size, MS_SYNC) == 0;
+		munmap(map, file_size);
+		if (!synced)
+			throw std::runtime_error("Failed to write bmp file.");
+		DBGMSG("Map exported: " << path);
+	}
+};
+
+#endif
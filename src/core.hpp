@@ -32,9 +32,12 @@ SOFTWARE.
 #define CORE_HPP
 
 #include <SDL2/SDL.h>
+#include <cstddef>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -65,14 +68,46 @@ struct RenderData {
 	std::optional<SDL_Rect> srcrect {std::nullopt};
 	/** The portion of the screen to be rendered on (or the full render target if nullopt). */
 	std::optional<SDL_Rect> dstrect {std::nullopt};
-	/** The color or texture to be rendered on the target.  */
-	std::variant<SDL_Color, std::string> col_or_path_to_tex {SDL_Color{0, 0, 0, 255}};
+	/** Rects to be filled with the same color in a single draw call (only used
+	 * if batch is set and the rendering context holds a color). */
+	std::vector<SDL_Rect> dstrects;
+	/** Whether the color is filled into dstrects instead of dstrect.
+	 * A batch without rects draws nothing. */
+	bool batch {false};
+	/** The color or texture to be rendered on the target. The path must outlive the
+	 * rendering context (see intern()). */
+	std::variant<SDL_Color, std::string_view> col_or_path_to_tex {SDL_Color{0, 0, 0, 255}};
 	/** The angle with which the texture should be rotated by. */
 	float angle {0.0f};
 	/** The texture's flip state. */
 	SDL_RendererFlip flip {SDL_FLIP_NONE};
 };
 
+/** Returns a view of a copy of the given string that lives until the end
+ * of the program. Interning the same string twice returns the same view,
+ * so paths can be stored and passed around per frame without copying.
+ * Safe to call from multiple threads.
+ * @param str The string to intern. */
+inline std::string_view intern(std::string_view str) {
+	static std::mutex mtx;
+	static std::set<std::string, std::less<>> strings;
+	std::lock_guard<std::mutex> lock(mtx);
+	auto it = strings.find(str);
+	if (it == strings.end())
+		it = strings.emplace(str).first;
+	return *it;
+}
+
+/** POD struct that counts the draw calls made by an Sdl object. */
+struct DrawStats {
+	/** The number of calls that filled rects. */
+	std::size_t fill_calls {0};
+	/** The number of rects filled. */
+	std::size_t filled_rects {0};
+	/** The number of textures copied. */
+	std::size_t copies {0};
+};
+
 /** Class to manage SDL objects and functionalities. */
 class Sdl {
 
@@ -97,17 +132,41 @@ private:
 	Base base;
 	Window win;
 	Renderer ren;
-	std::map<std::string, Texture> textures_map;
+	std::map<std::string, Texture, std::less<>> textures_map;
+	std::optional<SDL_Color> draw_col {std::nullopt};
+	DrawStats stats;
 	bool is_running {true};
 	int scroll_state {0};
 	std::pair<int, int> mouse_pos;
 	bool left_click {false};
+	bool right_click {false};
 	bool f_key {false};
 	bool r_key {false};
 	bool s_key {false};
+	bool c_key {false};
+	bool v_key {false};
+	int digit_key {-1};
+	bool digit_shift {false};
+	std::pair<int, int> arrows {0, 0};
+	bool search_mode {false};
+	std::string search_query;
+	std::string title;
+
+	// Private methods.
+
+	/** Shows the search query in the window title while searching. */
+	void update_title() {
+		std::string t = title;
+		if (search_mode || !search_query.empty())
+			t += " - search: " + search_query;
+		SDL_SetWindowTitle(win.get(), t.c_str());
+	}
 
 public:
 
+	/** The maximum length of the search query in bytes. */
+	static constexpr std::size_t max_search_len {63};
+
 	Sdl(
 		Uint32 init_flags,
 		std::string_view title,
@@ -142,15 +201,27 @@ public:
 					DBGMSG("Renderer destroyed.");
 				}
 			}
-		)
-	{}
+		),
+		title(title)
+	{
+		// Text input is only enabled while typing a search query.
+		SDL_StopTextInput();
+		search_query.reserve(max_search_len);
+	}
 	
-	/** Sets the color of the renderer.
+	/** Sets the color of the renderer. Does nothing if the color is already set.
 	 * @param col The color or the renderer.
 	 * @throws std::runtime_error on failure. */
 	void set_draw_color(SDL_Color col) {
+		if (
+			draw_col.has_value() &&
+			draw_col->r == col.r && draw_col->g == col.g &&
+			draw_col->b == col.b && draw_col->a == col.a
+		)
+			return;
 		if (SDL_SetRenderDrawColor(ren.get(), col.r, col.g, col.b, col.a))
 			throw std::runtime_error("Failed to set draw color.");
+		draw_col = col;
 	}
 
 	/** Clears the renderer with the specified color.
@@ -198,9 +269,22 @@ public:
 				}
 			}
 		);
+		load_texture(path_to_bmp, sur.get());
+	}
+
+	/** Creates and stores a texture from an existing surface if the given
+	 * texture has not been created yet. The surface is not taken ownership of.
+	 * @param name The name the texture can be referred to by.
+	 * @param sur The surface to create the texture from.
+	 * @throws std::runtime_error on failure.  */
+	void load_texture(std::string_view name, SDL_Surface* sur) {
+		if (textures_map.find(name) != textures_map.end()) {
+			DBGMSG("Texture was loaded earlier for: " << name);
+			return;
+		}
 		auto tex = Texture(
 			[&](){
-				auto t = SDL_CreateTextureFromSurface(ren.get(), sur.get());
+				auto t = SDL_CreateTextureFromSurface(ren.get(), sur);
 				if (!t) throw std::runtime_error("Failed to create texture.");
 				DBGMSG("Texture created.");
 				return t;
@@ -212,7 +296,7 @@ public:
 				}
 			}
 		);
-		if (!textures_map.emplace(path_to_bmp, std::move(tex)).second)
+		if (!textures_map.emplace(name, std::move(tex)).second)
 			throw std::runtime_error("Failed to emplace new texture into map.");
 		DBGMSG("New texture emplaced into map.");
 	}
@@ -231,13 +315,54 @@ public:
 	void poll_events() {
 		bool is_scrolling = false;
 		left_click = false;
+		right_click = false;
 		r_key = false;
 		f_key = false;
 		s_key = false;
+		c_key = false;
+		v_key = false;
+		digit_key = -1;
+		digit_shift = false;
+		arrows = {0, 0};
 		SDL_Event event;
 		while (SDL_PollEvent(&event)) {
 			switch (event.type) {
+				case SDL_TEXTINPUT:
+					if (search_mode) {
+						std::string_view text(event.text.text);
+						if (search_query.size() + text.size() <= max_search_len)
+							search_query += text;
+						update_title();
+					}
+					break;
 				case SDL_KEYDOWN:
+					if (search_mode) {
+						if (event.key.keysym.sym == SDLK_BACKSPACE && !search_query.empty()) {
+							// Remove a whole UTF-8 character.
+							while (
+								search_query.size() > 1 &&
+								(static_cast<unsigned char>(search_query.back()) & 0xC0) == 0x80
+							)
+								search_query.pop_back();
+							search_query.pop_back();
+						}
+						if (event.key.keysym.sym == SDLK_ESCAPE)
+							search_query.clear();
+						if (
+							event.key.keysym.sym == SDLK_ESCAPE ||
+							event.key.keysym.sym == SDLK_RETURN
+						) {
+							search_mode = false;
+							SDL_StopTextInput();
+						}
+						update_title();
+						break;
+					}
+					if (event.key.keysym.sym == SDLK_SLASH) {
+						search_mode = true;
+						SDL_StartTextInput();
+						update_title();
+					}
 					if (event.key.keysym.sym == SDLK_q)
 						is_running = false;
 					if (event.key.keysym.sym == SDLK_f)
@@ -246,6 +371,22 @@ public:
 						r_key = true;
 					if (event.key.keysym.sym == SDLK_s)
 						s_key = true;
+					if (event.key.keysym.sym == SDLK_c)
+						c_key = true;
+					if (event.key.keysym.sym == SDLK_v)
+						v_key = true;
+					if (event.key.keysym.sym >= SDLK_0 && event.key.keysym.sym <= SDLK_9) {
+						digit_key = event.key.keysym.sym - SDLK_0;
+						digit_shift = event.key.keysym.mod & KMOD_SHIFT;
+					}
+					if (event.key.keysym.sym == SDLK_LEFT)
+						arrows.first--;
+					if (event.key.keysym.sym == SDLK_RIGHT)
+						arrows.first++;
+					if (event.key.keysym.sym == SDLK_UP)
+						arrows.second--;
+					if (event.key.keysym.sym == SDLK_DOWN)
+						arrows.second++;
 					break;
 				case SDL_MOUSEWHEEL:
 					is_scrolling = true;
@@ -254,6 +395,8 @@ public:
 				case SDL_MOUSEBUTTONDOWN:
 					if (event.button.button == SDL_BUTTON_LEFT)
 						left_click = true;
+					if (event.button.button == SDL_BUTTON_RIGHT)
+						right_click = true;
 					break;
 				default: break;
 			}
@@ -290,6 +433,12 @@ public:
 		return left_click;
 	}
 
+	/** Get the current state of the right mouse button.
+	 * @return true if right mouse button is down, ortherwise false. */
+	bool get_right_click() {
+		return right_click;
+	}
+
 	/** Get the current state of the f key.
 	 * @return true if the f key is down, ortherwise false. */
 	bool get_f_key() {
@@ -302,12 +451,56 @@ public:
 		return r_key;
 	}
 
+	/** Get the arrow key presses since the last poll.
+	 * @return The horizontal and vertical sum of the presses (right and down are positive). */
+	std::pair<int, int> get_arrows() {
+		return arrows;
+	}
+
+	/** Get the current search query typed after pressing the slash key. */
+	std::string_view get_search_query() {
+		return search_query;
+	}
+
 	/** Get the current state of the s key.
 	 * @return true if the s key is down, ortherwise false. */
 	bool get_s_key() {
 		return s_key;
 	}
 
+	/** Get the current state of the c key.
+	 * @return true if the c key is down, ortherwise false. */
+	bool get_c_key() {
+		return c_key;
+	}
+
+	/** Get the current state of the v key.
+	 * @return true if the v key is down, ortherwise false. */
+	bool get_v_key() {
+		return v_key;
+	}
+
+	/** Get the digit key pressed since the last poll.
+	 * @return The digit or -1 if no digit key was pressed. */
+	int get_digit_key() {
+		return digit_key;
+	}
+
+	/** Get whether shift was held while the digit key was pressed. */
+	bool get_digit_shift() {
+		return digit_shift;
+	}
+
+	/** Get the draw calls counted since the last reset. */
+	const DrawStats& get_draw_stats() const {
+		return stats;
+	}
+
+	/** Resets the draw call counters. */
+	void reset_draw_stats() {
+		stats = {};
+	}
+
 	/** Draws the specified rendering context.
 	 * @param data The rendering context to be drawn.
 	 * @throws std::runtime_error on failure.  */
@@ -316,8 +509,8 @@ public:
 			data.srcrect.has_value() ? &data.srcrect.value() : nullptr;
 		const SDL_Rect* dstrect =
 			data.dstrect.has_value() ? &data.dstrect.value() : nullptr;
-		if (std::holds_alternative<std::string>(data.col_or_path_to_tex)) {
-			auto tex = textures_map.find(std::get<std::string>(data.col_or_path_to_tex));
+		if (std::holds_alternative<std::string_view>(data.col_or_path_to_tex)) {
+			auto tex = textures_map.find(std::get<std::string_view>(data.col_or_path_to_tex));
 			if (tex == textures_map.end())
 				throw std::runtime_error("Failed to find texture.");
 			if (
@@ -325,12 +518,28 @@ public:
 				data.angle, nullptr, data.flip)
 			)
 				throw std::runtime_error("Failed to render texture.");
+			stats.copies++;
 			DBGMSG("Texture rendered.");
 		} else if (std::holds_alternative<SDL_Color>(data.col_or_path_to_tex)) {
+			if (data.batch && data.dstrects.empty())
+				return;
 			SDL_Color col = std::get<SDL_Color>(data.col_or_path_to_tex);
 			set_draw_color(col);
+			if (data.batch) {
+				if (
+					SDL_RenderFillRects(ren.get(), data.dstrects.data(),
+					static_cast<int>(data.dstrects.size()))
+				)
+					throw std::runtime_error("Failed to fill rects.");
+				stats.fill_calls++;
+				stats.filled_rects += data.dstrects.size();
+				DBGMSG(data.dstrects.size() << " rects rendered.");
+				return;
+			}
 			if (SDL_RenderFillRect(ren.get(), dstrect))
 				throw std::runtime_error("Failed to fill rect.");
+			stats.fill_calls++;
+			stats.filled_rects++;
 			DBGMSG("Rect rendered.");
 		}
 	}
@@ -338,7 +547,7 @@ public:
 	/** Draws the specified rendering contexts.
 	 * @param data A vector of rendering contexts to be drawn.
 	 * @throws std::runtime_error on failure. */
-	void draw(std::vector<RenderData> data) {
+	void draw(const std::vector<RenderData>& data) {
 		for (const auto& d : data) {
 			draw(d);
 		}
@@ -0,0 +1,267 @@
+/*
+MIT License
+
+Copyright (c) 2025 broskobandi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/** @file src/editor.hpp
+ * @brief Private header file for the Editor class.
+ * @details This file contains the definition of the Editor class which is
+ * responsible for running the Browser and the Tiles on a separate thread
+ * and for handing their rendering contexts to the render thread. */
+
+#ifndef EDITOR_HPP
+#define EDITOR_HPP
+
+#include "core.hpp"
+#include "alloc_tracker.hpp"
+#include "browser.hpp"
+#include "lockfree.hpp"
+#include "prefab.hpp"
+#include "tiles.hpp"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace Core;
+
+class Editor {
+public:
+
+	/** POD struct that contains the user input of a single frame. */
+	struct Input {
+		/** The current window size. */
+		std::pair<int, int> win_size {0, 0};
+		/** The current state of the mouse wheel. */
+		int scroll_state {0};
+		/** The current mouse position. */
+		std::pair<int, int> mouse_pos {0, 0};
+		/** The current state of the left mouse button. */
+		bool left_click {false};
+		/** The current state of the right mouse button. */
+		bool right_click {false};
+		/** The current state of the f key. */
+		bool f_key {false};
+		/** The current state of the r key. */
+		bool r_key {false};
+		/** The current state of the s key. */
+		bool s_key {false};
+		/** The current state of the c key. */
+		bool c_key {false};
+		/** The current state of the v key. */
+		bool v_key {false};
+		/** The digit key pressed (or -1). */
+		int digit_key {-1};
+		/** Whether shift was held while the digit key was pressed. */
+		bool digit_shift {false};
+		/** The time of the frame in milliseconds. */
+		Uint32 ticks {0};
+		/** The number of tiles to move the camera by. */
+		std::pair<int, int> pan {0, 0};
+		/** The null terminated search query of the browser. */
+		std::array<char, Sdl::max_search_len + 1> search_query {};
+	};
+
+	/** The rendering contexts of one editor state. The views inside only
+	 * refer to strings that are never modified, so a snapshot can be drawn
+	 * while the editor thread keeps working. */
+	struct Snapshot {
+		std::vector<RenderData> browser;
+		std::vector<RenderData> tiles;
+	};
+
+private:
+
+	static constexpr std::size_t input_capacity {64};
+
+	// Private variables.
+
+	Browser& browser;
+	Tiles& tiles;
+	Prefabs& prefabs;
+	SpscQueue<Input, input_capacity> inputs;
+	TripleBuffer<Snapshot> snapshots;
+	/** Input that did not fit into the queue (render thread only). */
+	std::optional<Input> pending;
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::atomic<bool> stop {false};
+	std::atomic<bool> failed {false};
+	/** The number of snapshots published so far. */
+	std::atomic<std::size_t> published {0};
+	std::exception_ptr error;
+	std::thread worker;
+
+	// Private methods.
+
+	/** Applies a single frame's input to the editor state.
+	 * @param input The input to apply. */
+	void apply(const Input& input) {
+		browser.search(input.search_query.data());
+		browser.update(input.win_size, input.scroll_state, input.mouse_pos, input.left_click);
+		tiles.update(
+			input.mouse_pos, input.left_click, browser.get_selected_bmp(),
+			browser.get_panel_w(), input.f_key, input.r_key, input.s_key, input.ticks, input.pan
+		);
+		if (input.right_click)
+			tiles.select(input.mouse_pos);
+		if (input.c_key)
+			tiles.copy();
+		if (input.v_key)
+			tiles.stamp(input.mouse_pos);
+		if (input.digit_key >= 0) {
+			// Prefabs are named after the digit they are saved to.
+			char name[2] {static_cast<char>('0' + input.digit_key), '\0'};
+			if (input.digit_shift) {
+				prefabs.save(name, tiles.get_clipboard());
+			} else if (const Prefab* prefab = prefabs.find(name)) {
+				tiles.set_clipboard(*prefab);
+			}
+		}
+	}
+
+	/** Copies the current rendering contexts into the back buffer and publishes it. */
+	void publish() {
+		AllocTracker::Scope scope(AllocTracker::Phase::RenderData);
+		auto& snapshot = snapshots.back_buffer();
+		snapshot.browser = browser.render_data();
+		snapshot.tiles = tiles.render_data();
+		snapshots.publish();
+		published.fetch_add(1, std::memory_order_release);
+	}
+
+	/** The body of the editor thread. */
+	void run() {
+		AllocTracker::Scope scope(AllocTracker::Phase::Update);
+		try {
+			while (true) {
+				{
+					std::unique_lock<std::mutex> lock(mtx);
+					cv.wait(lock, [&](){ return stop.load() || !inputs.empty(); });
+				}
+				if (stop.load())
+					break;
+				Input input;
+				while (inputs.pop(input))
+					apply(input);
+				publish();
+			}
+		} catch (...) {
+			error = std::current_exception();
+			failed.store(true, std::memory_order_release);
+		}
+	}
+
+	/** Merges a newer input into an older one that has not been applied yet.
+	 * One-shot events are kept, camera movements are added up, everything else is taken from the newer input. */
+	static Input merge(const Input& older, const Input& newer) {
+		Input input = newer;
+		input.left_click = older.left_click || newer.left_click;
+		input.right_click = older.right_click || newer.right_click;
+		input.c_key = older.c_key || newer.c_key;
+		input.v_key = older.v_key || newer.v_key;
+		if (newer.digit_key < 0) {
+			input.digit_key = older.digit_key;
+			input.digit_shift = older.digit_shift;
+		}
+		input.f_key = older.f_key || newer.f_key;
+		input.r_key = older.r_key || newer.r_key;
+		input.s_key = older.s_key || newer.s_key;
+		input.pan.first = older.pan.first + newer.pan.first;
+		input.pan.second = older.pan.second + newer.pan.second;
+		return input;
+	}
+
+public:
+
+	/** Constructor for the Editor class. Publishes the initial state and starts
+	 * the editor thread. The browser and the tiles must outlive the editor and
+	 * must not be touched by other threads while it runs.
+	 * @param browser The browser to update.
+	 * @param tiles The tiles to update.
+	 * @param prefabs The prefabs that can be saved and loaded into the clipboard. */
+	Editor(Browser& browser, Tiles& tiles, Prefabs& prefabs) :
+		browser(browser), tiles(tiles), prefabs(prefabs)
+	{
+		publish();
+		snapshots.acquire();
+		worker = std::thread([this](){ run(); });
+		DBGMSG("Editor thread started.");
+	}
+
+	~Editor() {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stop.store(true);
+		}
+		cv.notify_one();
+		worker.join();
+		DBGMSG("Editor thread stopped.");
+	}
+
+	Editor(const Editor&) = delete;
+	Editor& operator=(const Editor&) = delete;
+
+	/** Hands a frame's input to the editor thread without waiting for it.
+	 * If the editor thread has fallen behind, the input is merged into the
+	 * previous one that has not been handed over yet. Render thread only.
+	 * @param input The input to hand over. */
+	void push(const Input& input) {
+		if (pending.has_value()) {
+			if (inputs.push(*pending)) {
+				pending.reset();
+			} else {
+				pending = merge(*pending, input);
+				return;
+			}
+		}
+		if (!inputs.push(input))
+			pending = input;
+		{
+			// Only guards the wake-up; the editor thread never holds the lock while working.
+			std::lock_guard<std::mutex> lock(mtx);
+		}
+		cv.notify_one();
+	}
+
+	/** Returns the number of snapshots published so far. Once it has grown
+	 * past a value read before a push, the pushed input is in the next snapshot. */
+	std::size_t get_published() const {
+		return published.load(std::memory_order_acquire);
+	}
+
+	/** Returns the latest published snapshot. Render thread only.
+	 * @throws The exception the editor thread failed with, if any. */
+	const Snapshot& snapshot() {
+		if (failed.load(std::memory_order_acquire))
+			std::rethrow_exception(error);
+		snapshots.acquire();
+		return snapshots.front_buffer();
+	}
+};
+
+#endif
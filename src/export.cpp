@@ -0,0 +1,138 @@
+#define NDEBUG
+/** @file src/export.cpp
+ * @brief Command line tool that flattens a saved map into a single bmp
+ * without opening a window. */
+
+#include "compositor.hpp"
+#include "pack.hpp"
+#include "regions.hpp"
+#include "tiles.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+int main(int argc, char* argv[]) {
+
+	if (argc != 3 && argc != 4 && argc != 5 && argc != 6) {
+		std::cerr << "Usage: " << argv[0] << " <tiles.json> <output.bmp> [<assets.pack>]\n";
+		std::cerr << "       " << argv[0] << " <map directory> <cols> <rows> <output.bmp> [<assets.pack>]\n";
+		return 1;
+	}
+
+	try {
+
+		const SDL_Color bg_col {100, 100, 100, 255};
+		const int tile_size = 64;
+		bool paged = argc >= 5;
+		const char* output = paged ? argv[4] : argv[2];
+		const char* pack_path = paged ? (argc == 6 ? argv[5] : nullptr) : (argc == 4 ? argv[3] : nullptr);
+
+		std::optional<Compositor> compositor;
+		std::vector<std::string> packed;
+		auto add_pack = [&](){
+			if (!pack_path)
+				return;
+			Pack pack(pack_path);
+			for (const auto& e : pack.entries()) {
+				compositor->add_image(e.name, pack.surface(e).get());
+				packed.emplace_back(e.name);
+			}
+		};
+		// An animation is named after its directory; its first frame is exported.
+		auto first_frame = [&](const std::string& name){
+			std::string prefix = name + "/", first;
+			for (const auto& p : packed) {
+				if (p.compare(0, prefix.size(), prefix) == 0 && (first.empty() || p < first))
+					first = p;
+			}
+			std::error_code ec;
+			if (first.empty() && std::filesystem::is_directory(name, ec)) {
+				for (const auto& e : std::filesystem::directory_iterator(name)) {
+					auto p = e.path().string();
+					if (e.path().extension() == ".bmp" && (first.empty() || p < first))
+						first = p;
+				}
+			}
+			return first.empty() ? name : first;
+		};
+		auto place = [&](int col, int row, const Tile& t){
+			if (t.animation.empty()) {
+				compositor->place(col, row, t);
+				return;
+			}
+			Tile frame = t;
+			frame.path_to_bmp = intern(first_frame(std::string(t.animation)));
+			compositor->place(col, row, frame);
+		};
+
+		if (paged) {
+			RegionStore store(argv[1], std::atoi(argv[2]), std::atoi(argv[3]));
+			compositor.emplace(store.get_map_cols(), store.get_map_rows(), tile_size, bg_col);
+			add_pack();
+			store.for_each_tile(place);
+		} else {
+			std::ifstream file(argv[1]);
+			if (!file.is_open())
+				throw std::runtime_error("Failed to open .json file");
+			std::vector<Tile> tiles;
+			try {
+				tiles = json::parse(file).get<std::vector<Tile>>();
+			} catch (const json::exception&) {
+				throw std::runtime_error("Invalid .json file");
+			}
+			if (tiles.empty())
+				throw std::runtime_error("The map is empty.");
+			// The saved rects are on screen, next to the panel; make them relative to the map.
+			int x0 = tiles.front().rect.x, y0 = tiles.front().rect.y;
+			int size = tiles.front().rect.w, cols = 0, rows = 0;
+			for (const auto& t : tiles) {
+				x0 = std::min(x0, t.rect.x);
+				y0 = std::min(y0, t.rect.y);
+			}
+			for (const auto& t : tiles) {
+				cols = std::max(cols, (t.rect.x - x0) / size + 1);
+				rows = std::max(rows, (t.rect.y - y0) / size + 1);
+			}
+			compositor.emplace(cols, rows, size, bg_col);
+			add_pack();
+			// Changes made since the last compaction are only in the journal.
+			auto journal_path = std::filesystem::path(argv[1]).parent_path() / "tiles.journal";
+			if (std::filesystem::exists(journal_path)) {
+				Journal journal(journal_path, static_cast<Uint32>(tiles.size()));
+				auto restore = [&](std::size_t index, const Tile& state, std::string_view name){
+					auto& t = tiles[index];
+					t.is_set = state.is_set && !name.empty();
+					t.angle = state.angle;
+					t.flip = state.flip;
+					t.animation = {};
+					t.path_to_bmp = t.is_set ? intern(first_frame(std::string(name))) : std::string_view{};
+				};
+				journal.replay(restore, [&](Uint32 index, const Prefab& prefab){
+					int col = static_cast<int>(index) % cols, row = static_cast<int>(index) / cols;
+					for (int y = 0; y < prefab.get_rows() && row + y < rows; y++) {
+						for (int x = 0; x < prefab.get_cols() && col + x < cols; x++) {
+							const auto& t = prefab.at(x, y);
+							restore(static_cast<std::size_t>((row + y) * cols + col + x), t,
+								t.animation.empty() ? t.path_to_bmp : t.animation);
+						}
+					}
+				});
+			}
+			for (const auto& t : tiles)
+				place((t.rect.x - x0) / size, (t.rect.y - y0) / size, t);
+		}
+
+		compositor->save(output);
+
+	} catch (const std::runtime_error& e) {
+		std::cerr << e.what() << "\n";
+		std::cerr << SDL_GetError() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
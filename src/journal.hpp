@@ -0,0 +1,273 @@
+/*
+MIT License
+
+Copyright (c) 2025 broskobandi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/** @file src/journal.hpp
+ * @brief Private header file for the Journal class.
+ * @details This file contains the definition of the Journal class which is
+ * responsible for recording every change of the tiles in an append-only
+ * file, so that saving only has to make the new records durable and a
+ * crashed session can be recovered by replaying them over the base map.
+ *
+ * Layout of a journal file (native byte order):
+ * - Header: magic, number of tiles in the map.
+ * - Records: index, kind, flip, angle, name length, name. Every tile record
+ * holds the whole new state of a tile, so replaying one twice is harmless.
+ * A stamp record holds the index of the top left tile of the stamp followed
+ * by the size of the prefab and the prefab itself, so a stamp is a single
+ * record however many tiles it covers. */
+
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include "core.hpp"
+#include "prefab.hpp"
+#include "tile.hpp"
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Core;
+
+class Journal {
+private:
+
+	/** The on-disk header of a journal file. */
+	struct Header {
+		char magic[8];
+		Uint32 tile_count;
+	};
+
+	/** The kinds of records. */
+	enum class Kind : Uint8 {
+		EmptyTile,
+		SetTile,
+		Stamp
+	};
+
+	/** The fixed size part of a record. */
+	struct Record {
+		Uint32 index;
+		Uint8 kind;
+		Uint8 flip;
+		Uint16 name_len;
+		float angle;
+	};
+
+	static constexpr char magic[8] {'S', 'D', 'L', 'J', 'R', 'N', 'L', '2'};
+
+	// Private variables.
+
+	std::filesystem::path path;
+	int fd {-1};
+	Uint32 tile_count;
+	/** The number of records appended since the last reset. */
+	std::size_t count {0};
+	/** Reused to serialize a record so it is written with a single call. */
+	std::vector<char> buffer;
+
+	// Private methods.
+
+	/** Writes the whole buffer at the end of the file.
+	 * @throws std::runtime_error on failure. */
+	void write_all(const char* data, std::size_t size) {
+		while (size > 0) {
+			auto n = ::write(fd, data, size);
+			if (n < 0)
+				throw std::runtime_error("Failed to write journal.");
+			data += n;
+			size -= static_cast<std::size_t>(n);
+		}
+	}
+
+public:
+
+	/** Opens a journal, creating it if it does not exist.
+	 * @param path The path of the journal file.
+	 * @param tile_count The number of tiles in the map.
+	 * @throws std::runtime_error on failure or if the journal belongs to a
+	 * map of a different size. */
+	Journal(std::filesystem::path path, Uint32 tile_count) :
+		path(std::move(path)), tile_count(tile_count)
+	{
+		fd = open(this->path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+		if (fd < 0)
+			throw std::runtime_error("Failed to open journal.");
+		struct stat st;
+		if (fstat(fd, &st)) {
+			close(fd);
+			throw std::runtime_error("Failed to open journal.");
+		}
+		if (st.st_size == 0) {
+			Header header {};
+			std::memcpy(header.magic, magic, sizeof(magic));
+			header.tile_count = tile_count;
+			write_all(reinterpret_cast<const char*>(&header), sizeof(header));
+		} else {
+			Header header {};
+			if (
+				pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+				std::memcmp(header.magic, magic, sizeof(magic)) ||
+				header.tile_count != tile_count
+			) {
+				close(fd);
+				throw std::runtime_error("Journal does not match the map.");
+			}
+		}
+		DBGMSG("Journal opened: " << this->path);
+	}
+
+	~Journal() {
+		if (fd >= 0) {
+			close(fd);
+			DBGMSG("Journal closed.");
+		}
+	}
+
+	Journal(const Journal&) = delete;
+	Journal& operator=(const Journal&) = delete;
+
+	/** Calls a function with every complete record in the journal in the
+	 * order they were appended. A record torn by a crash is cut off.
+	 * @param apply Called with the index of the tile, its new state and
+	 * the name of its bmp or animation (empty if the tile is not set).
+	 * @param apply_stamp Called with the index of the top left tile of a
+	 * stamp and the stamped prefab.
+	 * @return The number of records replayed.
+	 * @throws std::runtime_error on failure. */
+	template <typename F, typename G>
+	std::size_t replay(F apply, G apply_stamp) {
+		struct stat st;
+		if (fstat(fd, &st))
+			throw std::runtime_error("Failed to read journal.");
+		std::vector<char> bytes(static_cast<std::size_t>(st.st_size));
+		if (pread(fd, bytes.data(), bytes.size(), 0) != static_cast<ssize_t>(bytes.size()))
+			throw std::runtime_error("Failed to read journal.");
+
+		std::size_t offset = sizeof(Header);
+		count = 0;
+		while (offset + sizeof(Record) <= bytes.size()) {
+			Record record;
+			std::memcpy(&record, bytes.data() + offset, sizeof(record));
+			if (offset + sizeof(record) + record.name_len > bytes.size())
+				break;
+			if (record.index >= tile_count || record.kind > static_cast<Uint8>(Kind::Stamp))
+				throw std::runtime_error("Invalid journal record.");
+			if (record.kind == static_cast<Uint8>(Kind::Stamp)) {
+				Uint32 size;
+				std::size_t start = offset + sizeof(record) + sizeof(size);
+				if (start > bytes.size())
+					break;
+				std::memcpy(&size, bytes.data() + start - sizeof(size), sizeof(size));
+				if (start + size > bytes.size())
+					break;
+				std::istringstream in(std::string(bytes.data() + start, size));
+				apply_stamp(record.index, Prefab::read(in));
+				offset = start + size;
+				count++;
+				continue;
+			}
+			Tile tile;
+			tile.is_set = record.kind == static_cast<Uint8>(Kind::SetTile);
+			tile.flip = static_cast<SDL_RendererFlip>(record.flip);
+			tile.angle = record.angle;
+			apply(
+				record.index, tile,
+				std::string_view(bytes.data() + offset + sizeof(record), record.name_len)
+			);
+			offset += sizeof(record) + record.name_len;
+			count++;
+		}
+		if (offset != bytes.size() && ftruncate(fd, static_cast<off_t>(offset)))
+			throw std::runtime_error("Failed to repair journal.");
+		return count;
+	}
+
+	/** Appends the new state of a tile. The record reaches the operating
+	 * system immediately, so it survives a crash of the editor.
+	 * @param index The index of the tile in the map.
+	 * @param tile The tile.
+	 * @throws std::runtime_error on failure. */
+	void append(Uint32 index, const Tile& tile) {
+		std::string_view name;
+		if (tile.is_set)
+			name = tile.animation.empty() ? tile.path_to_bmp : tile.animation;
+		Record record {
+			index, static_cast<Uint8>(tile.is_set ? Kind::SetTile : Kind::EmptyTile), static_cast<Uint8>(tile.flip),
+			static_cast<Uint16>(name.size()), tile.angle
+		};
+		buffer.resize(sizeof(record) + name.size());
+		std::memcpy(buffer.data(), &record, sizeof(record));
+		std::memcpy(buffer.data() + sizeof(record), name.data(), name.size());
+		write_all(buffer.data(), buffer.size());
+		count++;
+	}
+
+	/** Appends a stamp as a single record.
+	 * @param index The index of the top left tile of the stamp.
+	 * @param prefab The stamped prefab.
+	 * @throws std::runtime_error on failure. */
+	void append_stamp(Uint32 index, const Prefab& prefab) {
+		std::ostringstream out;
+		prefab.write(out);
+		std::string bytes = out.str();
+		Record record {index, static_cast<Uint8>(Kind::Stamp), 0, 0, 0.0f};
+		Uint32 size = static_cast<Uint32>(bytes.size());
+		buffer.resize(sizeof(record) + sizeof(size) + bytes.size());
+		std::memcpy(buffer.data(), &record, sizeof(record));
+		std::memcpy(buffer.data() + sizeof(record), &size, sizeof(size));
+		std::memcpy(buffer.data() + sizeof(record) + sizeof(size), bytes.data(), bytes.size());
+		write_all(buffer.data(), buffer.size());
+		count++;
+	}
+
+	/** Makes every appended record durable. The cost is proportional
+	 * to the number of records since the last sync.
+	 * @throws std::runtime_error on failure. */
+	void sync() {
+		if (fdatasync(fd))
+			throw std::runtime_error("Failed to sync journal.");
+	}
+
+	/** Drops every record, after the map has been compacted into the base file.
+	 * @throws std::runtime_error on failure. */
+	void reset() {
+		if (ftruncate(fd, sizeof(Header)) || fdatasync(fd))
+			throw std::runtime_error("Failed to reset journal.");
+		count = 0;
+	}
+
+	/** Returns the number of records since the last reset. */
+	std::size_t get_count() const {
+		return count;
+	}
+};
+
+#endif
@@ -0,0 +1,131 @@
+/*
+MIT License
+
+Copyright (c) 2025 broskobandi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/** @file src/lockfree.hpp
+ * @brief Private header file for the TripleBuffer and SpscQueue classes.
+ * @details This file contains the lock-free primitives used to pass data
+ * between the render thread and the editor thread. Both are meant for
+ * exactly one producer thread and one consumer thread. */
+
+#ifndef LOCKFREE_HPP
+#define LOCKFREE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/** Triple buffer that lets a writer publish values without ever waiting for
+ * the reader and lets the reader always grab the latest published value. */
+template <typename T>
+class TripleBuffer {
+private:
+
+	static constexpr unsigned index_mask {3};
+	static constexpr unsigned fresh_bit {4};
+
+	// Private variables.
+
+	std::array<T, 3> buffers;
+	/** Index of the buffer in the middle with fresh_bit set if it has
+	 * been published but not yet acquired. */
+	std::atomic<unsigned> middle {1};
+	/** Index of the buffer owned by the writer. */
+	unsigned back {0};
+	/** Index of the buffer owned by the reader. */
+	unsigned front {2};
+
+public:
+
+	/** Returns the buffer the writer can fill. Writer thread only. */
+	T& back_buffer() {
+		return buffers[back];
+	}
+
+	/** Publishes the back buffer and takes over the previous middle buffer.
+	 * The new back buffer holds older contents that are meant to be overwritten.
+	 * Writer thread only. */
+	void publish() {
+		back = middle.exchange(back | fresh_bit, std::memory_order_acq_rel) & index_mask;
+	}
+
+	/** Makes the latest published value the front buffer if there is one.
+	 * Reader thread only.
+	 * @return true if a new value was acquired. */
+	bool acquire() {
+		if (!(middle.load(std::memory_order_relaxed) & fresh_bit))
+			return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+		return true;
+	}
+
+	/** Returns the buffer owned by the reader. Reader thread only. */
+	const T& front_buffer() const {
+		return buffers[front];
+	}
+};
+
+/** Fixed capacity single-producer single-consumer queue. */
+template <typename T, std::size_t N>
+class SpscQueue {
+private:
+
+	// Private variables.
+
+	std::array<T, N> items;
+	std::atomic<std::size_t> head {0};
+	std::atomic<std::size_t> tail {0};
+
+public:
+
+	/** Appends an item to the queue. Producer thread only.
+	 * @param item The item to append.
+	 * @return false if the queue is full. */
+	bool push(const T& item) {
+		auto t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == N)
+			return false;
+		items[t % N] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** Removes the oldest item from the queue. Consumer thread only.
+	 * @param item Receives the removed item.
+	 * @return false if the queue is empty. */
+	bool pop(T& item) {
+		auto h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+		item = items[h % N];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** Checks whether the queue is empty. */
+	bool empty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+};
+
+#endif
@@ -2,14 +2,21 @@
 /** @file src/main.cpp */
 
 #include "core.hpp"
+#include "alloc_tracker.hpp"
 #include "browser.hpp"
+#include "editor.hpp"
+#include "pack.hpp"
 #include "tiles.hpp"
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <stdexcept>
 
 using namespace Core;
 
-int main(void) {
+int main(int argc, char* argv[]) {
 
 	SDL_Color bg_col{30, 70, 70, 255};
 
@@ -24,30 +31,77 @@ int main(void) {
 			SDL_RENDERER_PRESENTVSYNC
 		);
 
-		Browser browser(
-			sdl.win_size(),
-			0.1f,
-			{100, 100, 100, 255},
-			"/home/broskobandi/Projects/SDL2_editor/test/assets"
-		);
+		// The working directory or a pack file built from it.
+		std::filesystem::path path = argc > 1 ?
+			argv[1] : "/home/broskobandi/Projects/SDL2_editor/test/assets";
+
+		std::optional<Pack> pack;
+		if (path.extension() == ".pack")
+			pack.emplace(path);
 
-		sdl.load_texture(browser.get_paths_to_bmps());
+		Browser browser = pack.has_value() ?
+			Browser(sdl.win_size(), 0.1f, {100, 100, 100, 255}, *pack) :
+			Browser(sdl.win_size(), 0.1f, {100, 100, 100, 255}, path);
+
+		if (pack.has_value()) {
+			for (const auto& e : pack->entries())
+				sdl.load_texture(e.name, pack->surface(e).get());
+		} else {
+			sdl.load_texture(browser.get_paths_to_bmps());
+		}
 
 		// Tiles tiles(4, 4, 64, bg_col, browser.get_panel_w());
-		Tiles tiles(4, 4, 64, {100, 100, 100, 255}, browser.get_panel_w());
+		// A map directory and its size keep the map on disk instead of in memory.
+		// Otherwise the map saved last and the journal of the changes since then are restored.
+		Tiles tiles = argc > 4 ?
+			Tiles(
+				10, 12, 64, {100, 100, 100, 255}, browser.get_panel_w(),
+				std::make_unique<RegionStore>(argv[2], std::atoi(argv[3]), std::atoi(argv[4])),
+				browser.get_animations()
+			) :
+			Tiles(
+				4, 4, 64, {100, 100, 100, 255}, browser.get_panel_w(),
+				std::make_unique<Journal>("tiles.journal", 4 * 4), browser.get_animations()
+			);
+
+		// Editing runs on its own thread; this thread only polls and draws.
+		Prefabs prefabs("prefabs");
+		Editor editor(browser, tiles, prefabs);
 
 		while (sdl.get_is_running()) {
-			sdl.poll_events();
+			{
+				AllocTracker::Scope scope(AllocTracker::Phase::Events);
+				sdl.poll_events();
+				Editor::Input input;
+				input.win_size = sdl.win_size();
+				input.scroll_state = sdl.get_scroll_state();
+				input.mouse_pos = sdl.get_mouse_pos();
+				input.left_click = sdl.get_left_click();
+				input.right_click = sdl.get_right_click();
+				input.f_key = sdl.get_f_key();
+				input.r_key = sdl.get_r_key();
+				input.s_key = sdl.get_s_key();
+				input.c_key = sdl.get_c_key();
+				input.v_key = sdl.get_v_key();
+				input.digit_key = sdl.get_digit_key();
+				input.digit_shift = sdl.get_digit_shift();
+				input.ticks = SDL_GetTicks();
+				input.pan = sdl.get_arrows();
+				auto query = sdl.get_search_query();
+				query.copy(input.search_query.data(), query.size());
+				editor.push(input);
+			}
+			AllocTracker::Scope scope(AllocTracker::Phase::Draw);
+			const auto& snapshot = editor.snapshot();
 			sdl.clear(bg_col);
-
-			browser.update(sdl.win_size(), sdl.get_scroll_state(), sdl.get_mouse_pos(), sdl.get_left_click());
-			// tiles.update(browser.get_panel_w());
-			tiles.update(sdl.get_mouse_pos(), sdl.get_left_click(), browser.get_selected_bmp(), browser.get_panel_w(), sdl.get_f_key(), sdl.get_r_key(), sdl.get_s_key());
-			sdl.draw(browser.render_data());
-			sdl.draw(tiles.render_data());
+			sdl.draw(snapshot.browser);
+			sdl.draw(snapshot.tiles);
 			sdl.present();
 		}
 
+		if (AllocTracker::enabled())
+			AllocTracker::report(std::cout);
+
 	} catch (const std::runtime_error& e) {
 		std::cerr << e.what() << "\n";
 		std::cerr << SDL_GetError() << "\n";
@@ -0,0 +1,28 @@
+#define NDEBUG
+/** @file src/pack.cpp
+ * @brief Command line tool that bundles the bmps of a working directory
+ * into a pack file that the editor can memory map at startup. */
+
+#include "pack.hpp"
+#include <iostream>
+#include <stdexcept>
+
+int main(int argc, char* argv[]) {
+
+	if (argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " <directory> <output.pack>\n";
+		return 1;
+	}
+
+	try {
+
+		Pack::build(argv[1], argv[2]);
+
+	} catch (const std::runtime_error& e) {
+		std::cerr << e.what() << "\n";
+		std::cerr << SDL_GetError() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,316 @@
+/*
+MIT License
+
+Copyright (c) 2025 broskobandi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/** @file src/pack.hpp
+ * @brief Private header file for the Pack class.
+ * @details This file contains the definition of the Pack class which is
+ * responsible for building asset pack files and for memory mapping them so
+ * their pixels can be turned into surfaces without copying.
+ *
+ * Layout of a pack file (native byte order):
+ * - Header: magic, root directory length, entry count.
+ * - Index: one IndexEntry per bmp.
+ * - Names: the root directory followed by the name of every bmp.
+ * - Pixels: the pixel data of every bmp, each aligned to pixel_alignment. */
+
+#ifndef PACK_HPP
+#define PACK_HPP
+
+#include "core.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Core;
+
+class Pack {
+public:
+
+	/** POD struct that describes a single bmp stored in the pack. */
+	struct Entry {
+		/** The path of the bmp the pack was built from. */
+		std::string_view name;
+		/** The width of the image. */
+		int w;
+		/** The height of the image. */
+		int h;
+		/** The length of a row of pixels in bytes. */
+		int pitch;
+		/** The SDL_PixelFormatEnum of the pixels. */
+		Uint32 format;
+		/** The pixels inside the mapped file. */
+		const void* pixels;
+	};
+
+private:
+
+	/** The on-disk header of a pack file. */
+	struct Header {
+		char magic[8];
+		Uint32 root_len;
+		Uint32 count;
+	};
+
+	/** The on-disk index entry of a single bmp. */
+	struct IndexEntry {
+		Uint64 name_offset;
+		Uint64 pixels_offset;
+		Uint32 name_len;
+		Uint32 w, h, pitch;
+		Uint32 format;
+		Uint32 reserved;
+	};
+
+	static constexpr char magic[8] {'S', 'D', 'L', 'P', 'A', 'C', 'K', '1'};
+	static constexpr Uint64 pixel_alignment {64};
+
+	// Private variables.
+
+	void* map {MAP_FAILED};
+	std::size_t map_size {0};
+	std::string_view root;
+	std::vector<Entry> index;
+
+	// Private methods.
+
+	/** Returns a pointer into the mapped file after checking the bounds.
+	 * @param offset The offset into the file.
+	 * @param size The number of bytes that must be available.
+	 * @throws std::runtime_error if the range is outside the file. */
+	const char* at(Uint64 offset, Uint64 size) const {
+		if (offset > map_size || size > map_size - offset)
+			throw std::runtime_error("Pack file is truncated.");
+		return static_cast<const char*>(map) + offset;
+	}
+
+	/** Rounds the offset up to the pixel alignment. */
+	static Uint64 align(Uint64 offset) {
+		return (offset + pixel_alignment - 1) / pixel_alignment * pixel_alignment;
+	}
+
+public:
+
+	/** Memory maps a pack file and parses its index.
+	 * @param path The path to the pack file.
+	 * @throws std::runtime_error on failure. */
+	Pack(const std::filesystem::path& path) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error("Failed to open pack file.");
+		struct stat st;
+		if (fstat(fd, &st) || st.st_size < static_cast<off_t>(sizeof(Header))) {
+			close(fd);
+			throw std::runtime_error("Invalid pack file.");
+		}
+		map_size = static_cast<std::size_t>(st.st_size);
+		map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED)
+			throw std::runtime_error("Failed to map pack file.");
+		DBGMSG("Pack file mapped: " << path);
+
+		try {
+			Header header;
+			std::memcpy(&header, at(0, sizeof(Header)), sizeof(Header));
+			if (std::memcmp(header.magic, magic, sizeof(magic)))
+				throw std::runtime_error("Invalid pack file.");
+			Uint64 index_offset = sizeof(Header);
+			Uint64 names_offset = index_offset + Uint64{header.count} * sizeof(IndexEntry);
+			root = std::string_view(at(names_offset, header.root_len), header.root_len);
+			for (Uint32 i = 0; i < header.count; i++) {
+				IndexEntry e;
+				std::memcpy(&e, at(index_offset + i * sizeof(IndexEntry), sizeof(IndexEntry)),
+					sizeof(IndexEntry));
+				Entry entry;
+				entry.name = std::string_view(at(e.name_offset, e.name_len), e.name_len);
+				entry.w = static_cast<int>(e.w);
+				entry.h = static_cast<int>(e.h);
+				entry.pitch = static_cast<int>(e.pitch);
+				entry.format = e.format;
+				entry.pixels = at(e.pixels_offset, Uint64{e.pitch} * e.h);
+				index.push_back(entry);
+			}
+		} catch (const std::runtime_error&) {
+			munmap(map, map_size);
+			throw;
+		}
+		DBGMSG(index.size() << " bmp files found in pack.");
+	}
+
+	~Pack() {
+		if (map != MAP_FAILED) {
+			munmap(map, map_size);
+			DBGMSG("Pack file unmapped.");
+		}
+	}
+
+	Pack(const Pack&) = delete;
+	Pack& operator=(const Pack&) = delete;
+
+	/** Returns the directory the pack was built from. */
+	std::string_view get_root() const {
+		return root;
+	}
+
+	/** Returns the index of the pack. */
+	const std::vector<Entry>& entries() const {
+		return index;
+	}
+
+	/** Creates a surface that uses the mapped pixels of an entry without copying them.
+	 * The surface must not outlive the pack and must not be written to.
+	 * @param entry The entry to create the surface from.
+	 * @throws std::runtime_error on failure. */
+	Surface surface(const Entry& entry) const {
+		return Surface(
+			[&](){
+				auto s = SDL_CreateRGBSurfaceWithFormatFrom(
+					const_cast<void*>(entry.pixels), entry.w, entry.h,
+					static_cast<int>(SDL_BITSPERPIXEL(entry.format)),
+					entry.pitch, entry.format
+				);
+				if (!s) throw std::runtime_error("Failed to create surface from pack.");
+				return s;
+			}(),
+			[](SDL_Surface* s) {
+				if (s) SDL_FreeSurface(s);
+			}
+		);
+	}
+
+	/** Returns the lexically normal form of a directory path without a
+	 * trailing separator, so "assets/" and "./assets" both become "assets".
+	 * @param dir The path of the directory. */
+	static std::filesystem::path normalize_root(const std::filesystem::path& dir) {
+		auto root = dir.lexically_normal();
+		if (!root.has_filename() && root.has_relative_path())
+			root = root.parent_path();
+		return root;
+	}
+
+	/** Builds a pack file out of the bmp files found in a directory and
+	 * in its subdirectories (the frames of the animations).
+	 * @param dir The directory to pack.
+	 * @param out The path of the pack file to create.
+	 * @throws std::runtime_error on failure. */
+	static void build(const std::filesystem::path& dir, const std::filesystem::path& out) {
+		auto root = normalize_root(dir);
+		std::vector<std::string> paths;
+		try {
+			for (const auto& entry : std::filesystem::directory_iterator(root)) {
+				if (entry.is_directory()) {
+					for (const auto& frame : std::filesystem::directory_iterator(entry.path())) {
+						if (frame.path().extension() == ".bmp")
+							paths.push_back(frame.path().string());
+					}
+				} else if (entry.path().extension() == ".bmp") {
+					paths.push_back(entry.path().string());
+				}
+			}
+		} catch (const std::filesystem::filesystem_error&) {
+			throw std::runtime_error("Invalid path.");
+		}
+
+		std::vector<Surface> surfaces;
+		for (const auto& p : paths) {
+			surfaces.emplace_back(
+				[&](){
+					auto s = SDL_LoadBMP(p.data());
+					if (!s) throw std::runtime_error("Failed to load bmp.");
+					DBGMSG("Loaded bmp: " << p);
+					// Palettes are not stored, so indexed images are expanded.
+					if (s->format->palette) {
+						auto c = SDL_ConvertSurfaceFormat(s, SDL_PIXELFORMAT_ARGB8888, 0);
+						SDL_FreeSurface(s);
+						if (!c) throw std::runtime_error("Failed to convert bmp.");
+						s = c;
+					}
+					return s;
+				}(),
+				[](SDL_Surface* s) {
+					if (s) SDL_FreeSurface(s);
+				}
+			);
+		}
+
+		std::string root_str = root.string();
+		Header header;
+		std::memcpy(header.magic, magic, sizeof(magic));
+		header.root_len = static_cast<Uint32>(root_str.size());
+		header.count = static_cast<Uint32>(paths.size());
+
+		std::vector<IndexEntry> entries(paths.size());
+		Uint64 offset = sizeof(Header) + entries.size() * sizeof(IndexEntry) + root_str.size();
+		for (std::size_t i = 0; i < paths.size(); i++) {
+			entries[i].name_offset = offset;
+			entries[i].name_len = static_cast<Uint32>(paths[i].size());
+			offset += paths[i].size();
+		}
+		for (std::size_t i = 0; i < paths.size(); i++) {
+			const auto* s = surfaces[i].get();
+			offset = align(offset);
+			entries[i].pixels_offset = offset;
+			entries[i].w = static_cast<Uint32>(s->w);
+			entries[i].h = static_cast<Uint32>(s->h);
+			entries[i].pitch = static_cast<Uint32>(s->pitch);
+			entries[i].format = s->format->format;
+			entries[i].reserved = 0;
+			offset += Uint64{entries[i].pitch} * entries[i].h;
+		}
+
+		std::ofstream file(out, std::ios::binary);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to create pack file.");
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries.data()),
+			static_cast<std::streamsize>(entries.size() * sizeof(IndexEntry)));
+		file << root_str;
+		for (const auto& p : paths)
+			file << p;
+		for (std::size_t i = 0; i < paths.size(); i++) {
+			auto* s = surfaces[i].get();
+			auto pos = static_cast<Uint64>(file.tellp());
+			std::string padding(entries[i].pixels_offset - pos, '\0');
+			file << padding;
+			if (SDL_LockSurface(s))
+				throw std::runtime_error("Failed to lock surface.");
+			file.write(static_cast<const char*>(s->pixels),
+				static_cast<std::streamsize>(Uint64{entries[i].pitch} * entries[i].h));
+			SDL_UnlockSurface(s);
+		}
+		if (!file)
+			throw std::runtime_error("Failed to write pack file.");
+		DBGMSG(paths.size() << " bmp files packed into: " << out);
+	}
+};
+
+#endif
@@ -0,0 +1,252 @@
+/*
+MIT License
+
+Copyright (c) 2025 broskobandi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/** @file src/prefab.hpp
+ * @brief Private header file for the Prefab and Prefabs classes.
+ * @details This file contains the definition of the Prefab class which is an
+ * immutable rectangular block of tiles copied out of a map, and of the
+ * Prefabs class which keeps the named prefabs in a directory. The tiles of
+ * a prefab are shared by every copy of it (the clipboard, the library and
+ * the stamps placed on a map kept on disk); changing a prefab means
+ * creating a new one. */
+
+#ifndef PREFAB_HPP
+#define PREFAB_HPP
+
+#include "core.hpp"
+#include "tile.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace Core;
+
+class Prefab {
+private:
+
+	static constexpr char magic[8] {'S', 'D', 'L', 'P', 'F', 'B', '1', '\0'};
+	/** The largest number of columns or rows a serialized prefab may declare. */
+	static constexpr Uint32 max_side = 4096;
+
+	// Private variables.
+
+	int cols {0}, rows {0};
+	/** The tiles in row major order without their rects. */
+	std::shared_ptr<const std::vector<Tile>> tiles;
+
+public:
+
+	Prefab() = default;
+
+	/** Constructor for the Prefab class.
+	 * @param cols The number of columns.
+	 * @param rows The number of rows.
+	 * @param tiles The tiles in row major order.
+	 * @throws std::runtime_error if the number of tiles does not match. */
+	Prefab(int cols, int rows, std::vector<Tile> tiles) :
+		cols(cols), rows(rows),
+		tiles(std::make_shared<const std::vector<Tile>>(std::move(tiles)))
+	{
+		if (cols <= 0 || rows <= 0 || this->tiles->size() != static_cast<std::size_t>(cols * rows))
+			throw std::runtime_error("Invalid prefab dimensions.");
+	}
+
+	/** Checks whether the prefab has no tiles. */
+	bool empty() const {
+		return !tiles;
+	}
+
+	/** Returns the number of columns. */
+	int get_cols() const {
+		return cols;
+	}
+
+	/** Returns the number of rows. */
+	int get_rows() const {
+		return rows;
+	}
+
+	/** Returns a tile of the prefab.
+	 * @param col The column of the tile.
+	 * @param row The row of the tile. */
+	const Tile& at(int col, int row) const {
+		return (*tiles)[static_cast<std::size_t>(row * cols + col)];
+	}
+
+	/** Checks whether two prefabs share the same tiles. */
+	bool shares(const Prefab& other) const {
+		return tiles == other.tiles;
+	}
+
+	/** Reads a prefab written by write().
+	 * @param in The stream to read from.
+	 * @throws std::runtime_error if the data is invalid. */
+	static Prefab read(std::istream& in) {
+		char m[sizeof(magic)];
+		Uint32 cols, rows;
+		in.read(m, sizeof(m));
+		in.read(reinterpret_cast<char*>(&cols), sizeof(cols));
+		in.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+		if (!in || std::memcmp(m, magic, sizeof(magic)) || !cols || !rows || cols > max_side || rows > max_side)
+			throw std::runtime_error("Invalid prefab file.");
+		std::vector<Tile> tiles(cols * rows);
+		std::string path_to_bmp, animation;
+		for (auto& t : tiles) {
+			Uint8 is_set, flip;
+			Uint16 path_len, animation_len;
+			in.read(reinterpret_cast<char*>(&is_set), sizeof(is_set));
+			in.read(reinterpret_cast<char*>(&flip), sizeof(flip));
+			in.read(reinterpret_cast<char*>(&t.angle), sizeof(t.angle));
+			in.read(reinterpret_cast<char*>(&path_len), sizeof(path_len));
+			in.read(reinterpret_cast<char*>(&animation_len), sizeof(animation_len));
+			path_to_bmp.resize(path_len);
+			animation.resize(animation_len);
+			in.read(path_to_bmp.data(), path_len);
+			in.read(animation.data(), animation_len);
+			if (!in)
+				throw std::runtime_error("Invalid prefab file.");
+			t.is_set = is_set && !path_to_bmp.empty();
+			t.flip = static_cast<SDL_RendererFlip>(flip);
+			t.path_to_bmp = t.is_set ? intern(path_to_bmp) : std::string_view{};
+			t.animation = animation.empty() ? std::string_view{} : intern(animation);
+		}
+		return Prefab(static_cast<int>(cols), static_cast<int>(rows), std::move(tiles));
+	}
+
+	/** Writes the prefab in a form read() understands.
+	 * @param out The stream to write to. Check its state afterwards. */
+	void write(std::ostream& out) const {
+		Uint32 c = static_cast<Uint32>(cols);
+		Uint32 r = static_cast<Uint32>(rows);
+		out.write(magic, sizeof(magic));
+		out.write(reinterpret_cast<const char*>(&c), sizeof(c));
+		out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+		for (const auto& t : *tiles) {
+			std::string_view path_to_bmp = t.is_set ? t.path_to_bmp : std::string_view{};
+			Uint8 is_set = t.is_set;
+			Uint8 flip = static_cast<Uint8>(t.flip);
+			Uint16 path_len = static_cast<Uint16>(path_to_bmp.size());
+			Uint16 animation_len = static_cast<Uint16>(t.animation.size());
+			out.write(reinterpret_cast<const char*>(&is_set), sizeof(is_set));
+			out.write(reinterpret_cast<const char*>(&flip), sizeof(flip));
+			out.write(reinterpret_cast<const char*>(&t.angle), sizeof(t.angle));
+			out.write(reinterpret_cast<const char*>(&path_len), sizeof(path_len));
+			out.write(reinterpret_cast<const char*>(&animation_len), sizeof(animation_len));
+			out.write(path_to_bmp.data(), path_len);
+			out.write(t.animation.data(), animation_len);
+		}
+	}
+};
+
+class Prefabs {
+private:
+
+	// Private variables.
+
+	std::filesystem::path dir;
+	std::map<std::string, Prefab, std::less<>> prefabs;
+
+	// Private methods.
+
+	/** Reads a prefab from a file.
+	 * @throws std::runtime_error on failure. */
+	static Prefab read_file(const std::filesystem::path& path) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open prefab file.");
+		return Prefab::read(file);
+	}
+
+	/** Writes a prefab into a file.
+	 * @throws std::runtime_error on failure. */
+	static void write_file(const std::filesystem::path& path, const Prefab& prefab) {
+		auto tmp = path;
+		tmp += ".tmp";
+		{
+			std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+				throw std::runtime_error("Failed to open prefab file.");
+			prefab.write(file);
+			if (!file)
+				throw std::runtime_error("Failed to write prefab file.");
+		}
+		std::filesystem::rename(tmp, path);
+	}
+
+public:
+
+	/** Constructor for the Prefabs class. Loads every prefab in the directory.
+	 * Files that cannot be read are skipped.
+	 * @param dir The directory holding the prefab files. Created when the
+	 * first prefab is saved. */
+	Prefabs(std::filesystem::path dir) : dir(std::move(dir)) {
+		std::error_code ec;
+		if (!std::filesystem::is_directory(this->dir, ec))
+			return;
+		for (const auto& entry : std::filesystem::directory_iterator(this->dir)) {
+			if (entry.path().extension() != ".prefab")
+				continue;
+			try {
+				prefabs.emplace(entry.path().stem().string(), read_file(entry.path()));
+			} catch (const std::runtime_error& e) {
+				DBGMSG("Skipping prefab " << entry.path() << ": " << e.what());
+			}
+		}
+		DBGMSG("Prefabs loaded: " << prefabs.size());
+	}
+
+	/** Returns a prefab by name.
+	 * @param name The name of the prefab.
+	 * @return The prefab or nullptr if there is no prefab with that name. */
+	const Prefab* find(std::string_view name) const {
+		auto it = prefabs.find(name);
+		return it != prefabs.end() ? &it->second : nullptr;
+	}
+
+	/** Stores a prefab under a name and writes it into the directory.
+	 * The tiles are shared with the given prefab, not copied.
+	 * @param name The name of the prefab.
+	 * @param prefab The prefab. Empty prefabs are ignored.
+	 * @throws std::runtime_error on failure. */
+	void save(std::string_view name, const Prefab& prefab) {
+		if (prefab.empty())
+			return;
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+		if (ec)
+			throw std::runtime_error("Failed to create prefab directory.");
+		write_file(dir / (std::string(name) + ".prefab"), prefab);
+		prefabs.insert_or_assign(std::string(name), prefab);
+	}
+};
+
+#endif
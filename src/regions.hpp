@@ -0,0 +1,818 @@
+/*
+MIT License
+
+Copyright (c) 2025 broskobandi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+/** @file src/regions.hpp
+ * @brief Private header file for the RegionStore class.
+ * @details This file contains the definition of the RegionStore class which
+ * is responsible for keeping a map that does not fit into memory on disk,
+ * split into fixed size square regions of tiles. Regions near the camera
+ * are loaded in the background, clean regions are evicted above a memory
+ * cap, and dirty regions are written back in the background.
+ *
+ * Stamped prefabs are not copied into the regions. The store keeps a list
+ * of stamps referring to shared, immutable blocks of tiles, and a tile
+ * shows the newest stamp placed over it since it was last edited. Editing
+ * such a tile copies that one tile out of the block.
+ *
+ * Files in the map directory:
+ * - map.meta: the dimensions of the map.
+ * - <x>_<y>.region: the edited tiles of a region, with the number of
+ * stamps that had been placed when each of them was edited.
+ * - stamps: the stamps in the order they were placed (position, block).
+ * - blocks/<id>.prefab: the blocks, once each, named after their contents. */
+
+#ifndef REGIONS_HPP
+#define REGIONS_HPP
+
+#include "core.hpp"
+#include "prefab.hpp"
+#include "tile.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace Core;
+
+class RegionStore {
+private:
+
+	using Tiles = std::vector<Tile>;
+
+	/** The tiles of a region as stored on disk. */
+	struct Contents {
+		/** The tiles of the region in row major order. */
+		Tiles tiles;
+		/** The number of stamps placed before each tile was last edited.
+		 * Only stamps placed later can cover the tile. */
+		std::vector<Uint32> gens;
+	};
+
+	/** A region that is resident in memory. */
+	struct Region {
+		Contents contents;
+		/** Whether the tiles differ from what is (or is about to be) on disk. */
+		bool dirty {false};
+	};
+
+	/** A job for the io thread. */
+	struct Job {
+		/** The key of the region. */
+		Uint64 key;
+		/** The contents to write, or nullptr to load the region. */
+		std::shared_ptr<const Contents> contents;
+		/** The id of the load request (loads only). */
+		Uint64 request {0};
+	};
+
+	/** A region loaded in the background. */
+	struct Loaded {
+		Uint64 key;
+		/** The id of the load request it answers. */
+		Uint64 request;
+		Contents contents;
+	};
+
+	/** A prefab placed on the map. */
+	struct Stamp {
+		/** The position of the top left corner of the prefab in the map. */
+		int col, row;
+		/** The id of the block holding the tiles. */
+		Uint64 block;
+		Prefab prefab;
+	};
+
+	/** The on-disk layout of the metadata file of a map. */
+	struct Meta {
+		char magic[8];
+		Uint32 map_cols, map_rows, region_size;
+	};
+
+	/** The on-disk layout of a record of the stamps file. */
+	struct StampRecord {
+		Sint32 col, row;
+		Uint64 block;
+	};
+
+	static constexpr char magic[8] {'S', 'D', 'L', 'R', 'E', 'G', '2', '\0'};
+	static constexpr char meta_magic[8] {'S', 'D', 'L', 'M', 'A', 'P', '1', '\0'};
+	static constexpr char stamps_magic[8] {'S', 'D', 'L', 'S', 'T', 'M', 'P', '1'};
+
+	// Private variables.
+
+	std::filesystem::path dir;
+	int map_cols, map_rows, region_size;
+	std::size_t max_resident;
+
+	// Editor thread only.
+
+	/** Resident regions. */
+	std::unordered_map<Uint64, Region> resident;
+	/** Every stamp in the order it was placed. */
+	std::vector<Stamp> stamps;
+	/** The number of stamps already in the stamps file. */
+	std::size_t stamps_saved {0};
+	/** The indices of the stamps overlapping each region, in ascending order. */
+	std::unordered_map<Uint64, std::vector<Uint32>> stamped;
+	/** The distinct blocks stamped so far by id. */
+	std::vector<std::pair<Uint64, Prefab>> blocks;
+
+	// Shared with the io thread (guarded by mtx).
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::deque<Job> jobs;
+	/** Regions that were asked to be loaded but have not arrived yet, with
+	 * the id of the request whose result is still wanted. A region that
+	 * became resident some other way is removed, so an outdated result is
+	 * dropped instead of replacing newer tiles. */
+	std::unordered_map<Uint64, Uint64> loading;
+	/** The id of the last load request. */
+	Uint64 requests {0};
+	/** Loaded regions waiting to be picked up by poll(). */
+	std::vector<Loaded> loaded;
+	/** The latest contents of regions whose writes have not finished yet. */
+	std::unordered_map<Uint64, std::shared_ptr<const Contents>> writing;
+	std::exception_ptr error;
+	bool stop {false};
+
+	std::thread worker;
+
+	// Private methods.
+
+	static Uint64 key(int rx, int ry) {
+		return (static_cast<Uint64>(static_cast<Uint32>(rx)) << 32) | static_cast<Uint32>(ry);
+	}
+
+	static int key_x(Uint64 key) {
+		return static_cast<int>(static_cast<Uint32>(key >> 32));
+	}
+
+	static int key_y(Uint64 key) {
+		return static_cast<int>(static_cast<Uint32>(key));
+	}
+
+	/** Returns the key of the region holding a tile. */
+	Uint64 key_of(int col, int row) const {
+		return key(col / region_size, row / region_size);
+	}
+
+	/** Returns the index of a tile within its region. */
+	std::size_t offset(int col, int row) const {
+		return static_cast<std::size_t>((row % region_size) * region_size + col % region_size);
+	}
+
+	/** Returns the path of the file of a region. */
+	std::filesystem::path region_path(Uint64 k) const {
+		return dir / (std::to_string(key_x(k)) + "_" + std::to_string(key_y(k)) + ".region");
+	}
+
+	/** Returns the path of the file of a block. */
+	std::filesystem::path block_path(Uint64 id) const {
+		char name[17];
+		std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(id));
+		return dir / "blocks" / (std::string(name) + ".prefab");
+	}
+
+	/** Writes the dimensions of the map into the metadata file of the
+	 * directory, or checks them against it if it already exists.
+	 * @throws std::runtime_error on failure or if the directory holds a map
+	 * of a different size. */
+	void check_meta() const {
+		Meta meta {};
+		std::memcpy(meta.magic, meta_magic, sizeof(meta_magic));
+		meta.map_cols = static_cast<Uint32>(map_cols);
+		meta.map_rows = static_cast<Uint32>(map_rows);
+		meta.region_size = static_cast<Uint32>(region_size);
+		auto path = dir / "map.meta";
+		std::ifstream in(path, std::ios::binary);
+		if (in.is_open()) {
+			Meta saved {};
+			in.read(reinterpret_cast<char*>(&saved), sizeof(saved));
+			if (!in || std::memcmp(&saved, &meta, sizeof(meta)))
+				throw std::runtime_error("Map directory does not match the map.");
+			return;
+		}
+		auto tmp = path;
+		tmp += ".tmp";
+		{
+			std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char*>(&meta), sizeof(meta));
+			if (!out)
+				throw std::runtime_error("Failed to write map metadata.");
+		}
+		std::filesystem::rename(tmp, path);
+	}
+
+	/** Reads a region from its file. A missing file is an empty region.
+	 * @throws std::runtime_error on failure. */
+	Contents read_file(Uint64 k) const {
+		Contents contents;
+		contents.tiles.resize(static_cast<std::size_t>(region_size * region_size));
+		contents.gens.resize(contents.tiles.size());
+		std::ifstream file(region_path(k), std::ios::binary);
+		if (!file.is_open())
+			return contents;
+		char m[sizeof(magic)];
+		Uint32 count;
+		file.read(m, sizeof(m));
+		file.read(reinterpret_cast<char*>(&count), sizeof(count));
+		if (!file || std::memcmp(m, magic, sizeof(magic)))
+			throw std::runtime_error("Invalid region file.");
+		std::string path, animation;
+		for (Uint32 i = 0; i < count; i++) {
+			Uint32 index, gen;
+			Uint8 flip;
+			float angle;
+			Uint16 path_len, animation_len;
+			file.read(reinterpret_cast<char*>(&index), sizeof(index));
+			file.read(reinterpret_cast<char*>(&gen), sizeof(gen));
+			file.read(reinterpret_cast<char*>(&flip), sizeof(flip));
+			file.read(reinterpret_cast<char*>(&angle), sizeof(angle));
+			file.read(reinterpret_cast<char*>(&path_len), sizeof(path_len));
+			file.read(reinterpret_cast<char*>(&animation_len), sizeof(animation_len));
+			path.resize(path_len);
+			animation.resize(animation_len);
+			file.read(path.data(), path_len);
+			file.read(animation.data(), animation_len);
+			if (!file || index >= contents.tiles.size())
+				throw std::runtime_error("Invalid region file.");
+			auto& t = contents.tiles[index];
+			t.is_set = !path.empty();
+			t.path_to_bmp = t.is_set ? intern(path) : std::string_view{};
+			t.animation = animation.empty() ? std::string_view{} : intern(animation);
+			t.angle = angle;
+			t.flip = static_cast<SDL_RendererFlip>(flip);
+			contents.gens[index] = gen;
+		}
+		return contents;
+	}
+
+	/** Writes a region into its file. Only tiles that differ from an empty
+	 * tile, or that hide a stamp, are stored, and a region without such
+	 * tiles has no file.
+	 * @throws std::runtime_error on failure. */
+	void write_file(Uint64 k, const Contents& contents) const {
+		const auto& tiles = contents.tiles;
+		std::vector<Uint32> used;
+		for (std::size_t i = 0; i < tiles.size(); i++) {
+			const auto& t = tiles[i];
+			if (t.is_set || t.angle != 0.0f || t.flip != SDL_FLIP_NONE || contents.gens[i])
+				used.push_back(static_cast<Uint32>(i));
+		}
+		auto path = region_path(k);
+		if (used.empty()) {
+			std::error_code ec;
+			std::filesystem::remove(path, ec);
+			return;
+		}
+		auto tmp = path;
+		tmp += ".tmp";
+		{
+			std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+				throw std::runtime_error("Failed to open region file.");
+			Uint32 count = static_cast<Uint32>(used.size());
+			file.write(magic, sizeof(magic));
+			file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+			for (auto index : used) {
+				const auto& t = tiles[index];
+				std::string_view path_to_bmp = t.is_set ? t.path_to_bmp : std::string_view{};
+				Uint8 flip = static_cast<Uint8>(t.flip);
+				Uint16 path_len = static_cast<Uint16>(path_to_bmp.size());
+				Uint16 animation_len = static_cast<Uint16>(t.animation.size());
+				file.write(reinterpret_cast<const char*>(&index), sizeof(index));
+				file.write(reinterpret_cast<const char*>(&contents.gens[index]), sizeof(Uint32));
+				file.write(reinterpret_cast<const char*>(&flip), sizeof(flip));
+				file.write(reinterpret_cast<const char*>(&t.angle), sizeof(t.angle));
+				file.write(reinterpret_cast<const char*>(&path_len), sizeof(path_len));
+				file.write(reinterpret_cast<const char*>(&animation_len), sizeof(animation_len));
+				file.write(path_to_bmp.data(), path_len);
+				file.write(t.animation.data(), animation_len);
+			}
+			if (!file)
+				throw std::runtime_error("Failed to write region file.");
+		}
+		std::filesystem::rename(tmp, path);
+	}
+
+	/** Returns the latest contents of a region, preferring writes that
+	 * have not reached the disk yet. */
+	Contents read_region(Uint64 k) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			auto w = writing.find(k);
+			if (w != writing.end())
+				return *w->second;
+		}
+		return read_file(k);
+	}
+
+	/** The body of the io thread. */
+	void run() {
+		std::unique_lock<std::mutex> lock(mtx);
+		while (true) {
+			cv.wait(lock, [&](){ return stop || !jobs.empty(); });
+			if (jobs.empty())
+				break;
+			Job job = std::move(jobs.front());
+			jobs.pop_front();
+			lock.unlock();
+			try {
+				if (job.contents) {
+					write_file(job.key, *job.contents);
+					lock.lock();
+					auto w = writing.find(job.key);
+					if (w != writing.end() && w->second == job.contents)
+						writing.erase(w);
+				} else {
+					auto contents = read_region(job.key);
+					lock.lock();
+					loaded.push_back({job.key, job.request, std::move(contents)});
+				}
+			} catch (...) {
+				if (!lock.owns_lock())
+					lock.lock();
+				if (!error)
+					error = std::current_exception();
+			}
+		}
+	}
+
+	/** Records a stamp and indexes it under every region it overlaps. */
+	void add_stamp(int col, int row, Uint64 block, const Prefab& prefab) {
+		auto index = static_cast<Uint32>(stamps.size());
+		stamps.push_back({col, row, block, prefab});
+		int rx1 = (std::min(col + prefab.get_cols(), map_cols) - 1) / region_size;
+		int ry1 = (std::min(row + prefab.get_rows(), map_rows) - 1) / region_size;
+		for (int ry = row / region_size; ry <= ry1; ry++) {
+			for (int rx = col / region_size; rx <= rx1; rx++)
+				stamped[key(rx, ry)].push_back(index);
+		}
+	}
+
+	/** Returns the id of the block holding the tiles of a prefab and the
+	 * prefab kept for it, which is an earlier one if the tiles are the same.
+	 * Only the first stamp of a prefab serializes it to compute the id. */
+	std::pair<Uint64, Prefab> find_block(const Prefab& prefab) {
+		for (const auto& b : blocks) {
+			if (b.second.shares(prefab))
+				return b;
+		}
+		std::ostringstream out;
+		prefab.write(out);
+		Uint64 id = 14695981039346656037ull;
+		for (char c : out.str()) {
+			id ^= static_cast<unsigned char>(c);
+			id *= 1099511628211ull;
+		}
+		for (const auto& b : blocks) {
+			if (b.first == id)
+				return b;
+		}
+		blocks.emplace_back(id, prefab);
+		return blocks.back();
+	}
+
+	/** Reads the stamps placed in earlier sessions. A record torn by a
+	 * crash is cut off.
+	 * @throws std::runtime_error on failure. */
+	void load_stamps() {
+		auto path = dir / "stamps";
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file.is_open())
+				return;
+			char m[sizeof(stamps_magic)];
+			file.read(m, sizeof(m));
+			if (!file || std::memcmp(m, stamps_magic, sizeof(stamps_magic)))
+				throw std::runtime_error("Invalid stamps file.");
+			StampRecord record;
+			while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+				if (record.col < 0 || record.row < 0 || record.col >= map_cols || record.row >= map_rows)
+					throw std::runtime_error("Invalid stamps file.");
+				auto b = std::find_if(blocks.begin(), blocks.end(),
+					[&](const auto& b){ return b.first == record.block; });
+				if (b == blocks.end()) {
+					std::ifstream block(block_path(record.block), std::ios::binary);
+					if (!block.is_open())
+						throw std::runtime_error("Missing stamp block.");
+					blocks.emplace_back(record.block, Prefab::read(block));
+					b = blocks.end() - 1;
+				}
+				add_stamp(record.col, record.row, record.block, b->second);
+			}
+		}
+		stamps_saved = stamps.size();
+		auto size = sizeof(stamps_magic) + stamps.size() * sizeof(StampRecord);
+		if (std::filesystem::file_size(path) != size)
+			std::filesystem::resize_file(path, size);
+		DBGMSG("Stamps loaded: " << stamps.size());
+	}
+
+	/** Appends the stamps placed since the last call to the stamps file,
+	 * writing the blocks that are not on disk yet first.
+	 * @throws std::runtime_error on failure. */
+	void save_stamps() {
+		if (stamps_saved == stamps.size())
+			return;
+		std::error_code ec;
+		std::filesystem::create_directories(dir / "blocks", ec);
+		if (ec)
+			throw std::runtime_error("Failed to create block directory.");
+		auto path = dir / "stamps";
+		bool fresh = !std::filesystem::exists(path);
+		std::ofstream file(path, std::ios::binary | std::ios::app);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open stamps file.");
+		if (fresh)
+			file.write(stamps_magic, sizeof(stamps_magic));
+		for (std::size_t i = stamps_saved; i < stamps.size(); i++) {
+			const auto& s = stamps[i];
+			auto block = block_path(s.block);
+			if (!std::filesystem::exists(block)) {
+				auto tmp = block;
+				tmp += ".tmp";
+				{
+					std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+					s.prefab.write(out);
+					if (!out)
+						throw std::runtime_error("Failed to write block file.");
+				}
+				std::filesystem::rename(tmp, block);
+			}
+			StampRecord record {s.col, s.row, s.block};
+			file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+		}
+		file.flush();
+		if (!file)
+			throw std::runtime_error("Failed to write stamps file.");
+		stamps_saved = stamps.size();
+	}
+
+	/** Returns the tile shown at a position: the newest stamp placed over
+	 * it since it was last edited, or else the tile itself.
+	 * @param k The key of the region holding the tile.
+	 * @param contents The contents of that region. */
+	const Tile& resolve(Uint64 k, const Contents& contents, int col, int row) const {
+		auto i = offset(col, row);
+		auto s = stamped.find(k);
+		if (s != stamped.end()) {
+			for (auto it = s->second.rbegin(); it != s->second.rend() && *it >= contents.gens[i]; ++it) {
+				const auto& stamp = stamps[*it];
+				int x = col - stamp.col, y = row - stamp.row;
+				if (x >= 0 && y >= 0 && x < stamp.prefab.get_cols() && y < stamp.prefab.get_rows())
+					return stamp.prefab.at(x, y);
+			}
+		}
+		return contents.tiles[i];
+	}
+
+	/** Hands a copy of a dirty region to the io thread and marks it clean.
+	 * The stamps are saved first, so no region on disk refers to a stamp
+	 * that is not. */
+	void write_back(Uint64 k, Region& region) {
+		save_stamps();
+		auto contents = std::make_shared<const Contents>(region.contents);
+		region.dirty = false;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			writing[k] = contents;
+			jobs.push_back({k, contents});
+		}
+		cv.notify_one();
+	}
+
+	/** Returns a resident region, loading it synchronously if needed. */
+	Region& get_region(Uint64 k) {
+		auto r = resident.find(k);
+		if (r != resident.end())
+			return r->second;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			loading.erase(k);
+		}
+		Region region;
+		region.contents = read_region(k);
+		return resident.emplace(k, std::move(region)).first->second;
+	}
+
+	/** Rethrows the first error of the io thread, if any. */
+	void check_error() {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	/** Throws if a tile is outside the map. */
+	void check_bounds(int col, int row) const {
+		if (col < 0 || row < 0 || col >= map_cols || row >= map_rows)
+			throw std::runtime_error("Tile is outside the map.");
+	}
+
+public:
+
+	/** Constructor for the RegionStore class.
+	 * @param dir The directory holding the region files. Created if missing,
+	 * together with a metadata file recording the dimensions below.
+	 * @param map_cols The number of columns of the whole map.
+	 * @param map_rows The number of rows of the whole map.
+	 * @param region_size The number of tiles along the side of a region.
+	 * @param max_resident The number of regions kept in memory at most
+	 * (dirty regions stay until they are written back).
+	 * @throws std::runtime_error on failure or if the directory holds a map
+	 * of different dimensions. */
+	RegionStore(
+		std::filesystem::path dir, int map_cols, int map_rows,
+		int region_size = 32, std::size_t max_resident = 64
+	) :
+		dir(std::move(dir)), map_cols(map_cols), map_rows(map_rows),
+		region_size(region_size), max_resident(max_resident)
+	{
+		if (map_cols <= 0 || map_rows <= 0 || region_size <= 0)
+			throw std::runtime_error("Invalid map dimensions.");
+		std::error_code ec;
+		std::filesystem::create_directories(this->dir, ec);
+		if (ec)
+			throw std::runtime_error("Failed to create map directory.");
+		check_meta();
+		load_stamps();
+		worker = std::thread([this](){ run(); });
+		DBGMSG("Region store opened: " << this->dir);
+	}
+
+	/** Writes back every dirty region and waits for the io thread to finish. */
+	~RegionStore() {
+		try {
+			flush();
+		} catch (const std::runtime_error&) {}
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stop = true;
+		}
+		cv.notify_one();
+		worker.join();
+		DBGMSG("Region store closed.");
+	}
+
+	RegionStore(const RegionStore&) = delete;
+	RegionStore& operator=(const RegionStore&) = delete;
+
+	/** Returns the number of columns of the whole map. */
+	int get_map_cols() const {
+		return map_cols;
+	}
+
+	/** Returns the number of rows of the whole map. */
+	int get_map_rows() const {
+		return map_rows;
+	}
+
+	/** Returns the number of resident regions. */
+	std::size_t get_resident_count() const {
+		return resident.size();
+	}
+
+	/** Returns the number of resident regions that have not been written back. */
+	std::size_t get_dirty_count() const {
+		return static_cast<std::size_t>(std::count_if(resident.begin(), resident.end(),
+			[](const auto& r){ return r.second.dirty; }));
+	}
+
+	/** Returns a tile if its region is resident. A stamped tile that has
+	 * not been edited since lives in the stamped prefab.
+	 * @param col The column of the tile in the map.
+	 * @param row The row of the tile in the map.
+	 * @return The tile or nullptr if the region has not been loaded yet. */
+	const Tile* find(int col, int row) const {
+		auto k = key_of(col, row);
+		auto r = resident.find(k);
+		if (r == resident.end())
+			return nullptr;
+		return &resolve(k, r->second.contents, col, row);
+	}
+
+	/** Returns a copy of a tile without marking its region dirty. Loads the
+	 * region synchronously if it is not resident.
+	 * @param col The column of the tile in the map.
+	 * @param row The row of the tile in the map.
+	 * @throws std::runtime_error on failure. */
+	Tile get(int col, int row) {
+		check_bounds(col, row);
+		auto k = key_of(col, row);
+		return resolve(k, get_region(k).contents, col, row);
+	}
+
+	/** Returns a tile for editing and marks its region dirty. Loads the
+	 * region synchronously if it is not resident. If a stamp covers the
+	 * tile, the tile is copied out of it first and no longer follows it.
+	 * @param col The column of the tile in the map.
+	 * @param row The row of the tile in the map.
+	 * @throws std::runtime_error on failure. */
+	Tile& edit(int col, int row) {
+		check_bounds(col, row);
+		auto k = key_of(col, row);
+		auto& region = get_region(k);
+		auto i = offset(col, row);
+		auto& contents = region.contents;
+		const Tile& shown = resolve(k, contents, col, row);
+		if (&shown != &contents.tiles[i])
+			contents.tiles[i] = shown;
+		contents.gens[i] = static_cast<Uint32>(stamps.size());
+		region.dirty = true;
+		return contents.tiles[i];
+	}
+
+	/** Places a prefab on the map with its top left corner at a tile. The
+	 * tiles are not copied and no region is loaded or marked dirty: the
+	 * covered tiles refer to the prefab until they are edited. Parts
+	 * falling outside the map are ignored. The stamp is saved by the next
+	 * flush.
+	 * @param col The column of the top left corner.
+	 * @param row The row of the top left corner.
+	 * @param prefab The prefab. Empty prefabs are ignored.
+	 * @throws std::runtime_error if the corner is outside the map. */
+	void stamp(int col, int row, const Prefab& prefab) {
+		check_bounds(col, row);
+		if (prefab.empty())
+			return;
+		auto block = find_block(prefab);
+		add_stamp(col, row, block.first, block.second);
+	}
+
+	/** Visits every tile of an area of the map, one region at a time.
+	 * Regions that are not resident are read without becoming resident.
+	 * @param area The area in tiles. Parts outside the map are ignored.
+	 * @param visit Called with the column, the row and the tile.
+	 * @throws std::runtime_error on failure. */
+	template <typename F>
+	void for_each_in(SDL_Rect area, F visit) {
+		check_error();
+		int col0 = std::max(0, area.x), row0 = std::max(0, area.y);
+		int col1 = std::min(map_cols, area.x + area.w), row1 = std::min(map_rows, area.y + area.h);
+		if (col0 >= col1 || row0 >= row1)
+			return;
+		for (int ry = row0 / region_size; ry <= (row1 - 1) / region_size; ry++) {
+			for (int rx = col0 / region_size; rx <= (col1 - 1) / region_size; rx++) {
+				auto k = key(rx, ry);
+				auto r = resident.find(k);
+				Contents read;
+				if (r == resident.end())
+					read = read_region(k);
+				const Contents& contents = r != resident.end() ? r->second.contents : read;
+				int y1 = std::min(row1, (ry + 1) * region_size);
+				int x1 = std::min(col1, (rx + 1) * region_size);
+				for (int row = std::max(row0, ry * region_size); row < y1; row++) {
+					for (int col = std::max(col0, rx * region_size); col < x1; col++)
+						visit(col, row, resolve(k, contents, col, row));
+				}
+			}
+		}
+	}
+
+	/** Visits every tile of the map that has a bmp, one region at a time.
+	 * Regions that are not resident are read without becoming resident.
+	 * @param visit Called with the column, the row and the tile.
+	 * @throws std::runtime_error on failure. */
+	template <typename F>
+	void for_each_tile(F visit) {
+		for_each_in({0, 0, map_cols, map_rows}, [&](int col, int row, const Tile& t){
+			if (t.is_set)
+				visit(col, row, t);
+		});
+	}
+
+	/** Requests the regions around an area of the map in the background and
+	 * evicts the clean regions farthest from it while above the memory cap.
+	 * @param area The area in tiles (typically the camera).
+	 * @throws std::runtime_error if the io thread failed. */
+	void focus(SDL_Rect area) {
+		check_error();
+		int rx0 = std::max(0, area.x / region_size - 1);
+		int ry0 = std::max(0, area.y / region_size - 1);
+		int rx1 = std::min((map_cols - 1) / region_size, (area.x + area.w) / region_size + 1);
+		int ry1 = std::min((map_rows - 1) / region_size, (area.y + area.h) / region_size + 1);
+
+		bool requested = false;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			for (int ry = ry0; ry <= ry1; ry++) {
+				for (int rx = rx0; rx <= rx1; rx++) {
+					auto k = key(rx, ry);
+					if (resident.count(k) || loading.count(k))
+						continue;
+					loading[k] = ++requests;
+					jobs.push_back({k, nullptr, requests});
+					requested = true;
+				}
+			}
+		}
+		if (requested)
+			cv.notify_one();
+
+		if (resident.size() <= max_resident)
+			return;
+		auto distance = [&](Uint64 k){
+			int dx = std::max({0, rx0 - key_x(k), key_x(k) - rx1});
+			int dy = std::max({0, ry0 - key_y(k), key_y(k) - ry1});
+			return dx + dy;
+		};
+		std::vector<std::pair<int, Uint64>> candidates;
+		for (auto& [k, region] : resident) {
+			int d = distance(k);
+			if (d == 0)
+				continue;
+			if (region.dirty)
+				write_back(k, region);
+			candidates.emplace_back(d, k);
+		}
+		std::sort(candidates.begin(), candidates.end(), std::greater<>());
+		for (const auto& c : candidates) {
+			if (resident.size() <= max_resident)
+				break;
+			resident.erase(c.second);
+		}
+	}
+
+	/** Makes the regions loaded in the background resident. Results of
+	 * requests that are no longer wanted are dropped.
+	 * @return true if any region became resident.
+	 * @throws std::runtime_error if the io thread failed. */
+	bool poll() {
+		check_error();
+		std::vector<Loaded> arrived;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (loaded.empty())
+				return false;
+			arrived.swap(loaded);
+			for (auto& a : arrived) {
+				auto l = loading.find(a.key);
+				if (l != loading.end() && l->second == a.request)
+					loading.erase(l);
+				else
+					a.request = 0;
+			}
+		}
+		bool any = false;
+		for (auto& a : arrived) {
+			if (!a.request || resident.count(a.key))
+				continue;
+			Region region;
+			region.contents = std::move(a.contents);
+			resident.emplace(a.key, std::move(region));
+			any = true;
+		}
+		return any;
+	}
+
+	/** Saves the new stamps and writes back every dirty region in the
+	 * background. The cost is proportional to the number of regions edited
+	 * and of stamps placed since the last flush.
+	 * @throws std::runtime_error on failure. */
+	void flush() {
+		check_error();
+		save_stamps();
+		for (auto& [k, region] : resident) {
+			if (region.dirty)
+				write_back(k, region);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,173 @@
+/*
+MIT License
+
+Copyright (c) 2025 broskobandi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/** @file src/search.hpp
+ * @brief Private header file for the SearchIndex class.
+ * @details This file contains the definition of the SearchIndex class which
+ * is responsible for finding assets by the words in their names and in
+ * their directory components. */
+
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class SearchIndex {
+private:
+
+	// Private variables.
+
+	/** The words of every item. */
+	std::vector<std::vector<std::string>> item_words;
+	/** Every (word, item) pair sorted by word, so the items having a word
+	 * that starts with a given prefix form one contiguous range. */
+	std::vector<std::pair<std::string, std::size_t>> index;
+	std::string query;
+	std::vector<std::string> query_words;
+	/** The items matching the current query in insertion order. */
+	std::vector<std::size_t> results;
+
+	// Private methods.
+
+	/** Checks whether every query word is a prefix of one of the item's words.
+	 * @param item The item to check. */
+	bool matches(std::size_t item) const {
+		for (const auto& q : query_words) {
+			bool found = false;
+			for (const auto& w : item_words[item]) {
+				if (w.compare(0, q.size(), q) == 0) {
+					found = true;
+					break;
+				}
+			}
+			if (!found)
+				return false;
+		}
+		return true;
+	}
+
+	/** Returns the range of the index whose words start with the given prefix.
+	 * @param prefix The prefix to look up. */
+	auto prefix_range(const std::string& prefix) const {
+		auto first = std::lower_bound(
+			index.begin(), index.end(), prefix,
+			[](const auto& entry, const std::string& p){ return entry.first < p; }
+		);
+		auto last = first;
+		while (last != index.end() && last->first.compare(0, prefix.size(), prefix) == 0)
+			last++;
+		return std::make_pair(first, last);
+	}
+
+public:
+
+	/** Splits a string into lower case words of letters and digits.
+	 * @param str The string to split.
+	 * @param words Receives the words. */
+	static void split(std::string_view str, std::vector<std::string>& words) {
+		words.clear();
+		std::string word;
+		for (char c : str) {
+			auto u = static_cast<unsigned char>(c);
+			if (std::isalnum(u)) {
+				word.push_back(static_cast<char>(std::tolower(u)));
+			} else if (!word.empty()) {
+				words.push_back(std::move(word));
+				word.clear();
+			}
+		}
+		if (!word.empty())
+			words.push_back(std::move(word));
+	}
+
+	SearchIndex() = default;
+
+	/** Constructor for the SearchIndex class.
+	 * @param names The names of the items. The index of a name is the item's id. */
+	SearchIndex(const std::vector<std::string>& names) {
+		for (std::size_t i = 0; i < names.size(); i++) {
+			item_words.emplace_back();
+			split(names[i], item_words.back());
+			for (const auto& w : item_words.back())
+				index.emplace_back(w, i);
+			results.push_back(i);
+		}
+		std::sort(index.begin(), index.end());
+	}
+
+	/** Updates the results to the items matching the query.
+	 * If the query extends the previous one, only the previous results are
+	 * filtered. Otherwise the candidates come from the index range of the
+	 * most selective query word.
+	 * @param q The query. Every word in it must prefix a word of an item.
+	 * @return true if the query changed. */
+	bool search(std::string_view q) {
+		if (q == query)
+			return false;
+		bool narrowing = !query.empty() && q.substr(0, query.size()) == query;
+		query.assign(q);
+		split(query, query_words);
+
+		if (query_words.empty()) {
+			results.resize(item_words.size());
+			for (std::size_t i = 0; i < results.size(); i++)
+				results[i] = i;
+			return true;
+		}
+
+		if (!narrowing) {
+			auto best = prefix_range(query_words.front());
+			for (std::size_t i = 1; i < query_words.size(); i++) {
+				auto range = prefix_range(query_words[i]);
+				if (range.second - range.first < best.second - best.first)
+					best = range;
+			}
+			results.clear();
+			for (auto it = best.first; it != best.second; it++)
+				results.push_back(it->second);
+			std::sort(results.begin(), results.end());
+			results.erase(std::unique(results.begin(), results.end()), results.end());
+		}
+
+		results.erase(
+			std::remove_if(results.begin(), results.end(),
+				[&](std::size_t item){ return !matches(item); }),
+			results.end()
+		);
+		return true;
+	}
+
+	/** Returns the ids of the items matching the current query. */
+	const std::vector<std::size_t>& get_results() const {
+		return results;
+	}
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+MIT License
+
+Copyright (c) 2025 broskobandi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/** @file src/tile.hpp
+ * @brief Private header file for the Tile struct.
+ * @details This file contains the definition of the Tile struct which is
+ * shared by the Tiles class and the storage it uses. */
+
+#ifndef TILE_HPP
+#define TILE_HPP
+
+#include "core.hpp"
+#include <string_view>
+
+using namespace Core;
+
+/** POD struct that stores data for a single tile. */
+struct Tile {
+	/** The tile rect. */
+	SDL_Rect rect {0, 0, 0, 0};
+	/** Path to the bmp to be rendered in the tile (interned or owned by the animations). */
+	std::string_view path_to_bmp;
+	/** Boolean representing whether or not the tile's texture has been set. */
+	bool is_set {false};
+	/** The angle by which the texture should be rotated. */
+	float angle {0.0f};
+	/** Flip state of the texture. */
+	SDL_RendererFlip flip {SDL_FLIP_NONE};
+	/** Name of the animation played in the tile (or empty if the tile is static). */
+	std::string_view animation;
+};
+
+#endif
@@ -31,8 +31,19 @@ SOFTWARE.
 #define TILES_HPP
 
 #include "core.hpp"
+#include "animation.hpp"
+#include "journal.hpp"
+#include "prefab.hpp"
+#include "regions.hpp"
+#include "tile.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fstream>
 #include <nlohmann/json.hpp>
@@ -40,20 +51,6 @@ SOFTWARE.
 using namespace Core;
 using json = nlohmann::json;
 
-/** POD struct that stores data for a single tile. */
-struct Tile {
-	/** The tile rect. */
-	SDL_Rect rect {0, 0, 0, 0};
-	/** Path to the bmp to be rendered in the tile. */
-	std::string path_to_bmp;
-	/** Boolean representing whether or not the tile's texture has been set. */
-	bool is_set {false};
-	/** The angle by which the texture should be rotated. */
-	float angle {0.0f};
-	/** Flip state of the texture. */
-	SDL_RendererFlip flip {SDL_FLIP_NONE};
-};
-
 /** Function defining the desired layout into the json file. */
 inline void to_json(json& j, const Tile& t) {
 	j = json{
@@ -61,8 +58,9 @@ inline void to_json(json& j, const Tile& t) {
 		{"y", t.rect.y},
 		{"w", t.rect.w},
 		{"h", t.rect.h},
-		{"path_to_bmp", t.path_to_bmp},
-		{"angle", t.angle}, {"flip", t.flip}
+		{"path_to_bmp", std::string(t.path_to_bmp)},
+		{"angle", t.angle}, {"flip", t.flip},
+		{"animation", std::string(t.animation)}
 	};
 }
 
@@ -72,22 +70,178 @@ inline void from_json(const json& j, Tile& t) {
 	j.at("y").get_to(t.rect.y);
 	j.at("w").get_to(t.rect.w);
 	j.at("h").get_to(t.rect.h);
-	j.at("path_to_bmp").get_to(t.path_to_bmp);
+	t.path_to_bmp = intern(j.at("path_to_bmp").get<std::string>());
 	j.at("angle").get_to(t.angle);
 	j.at("flip").get_to(t.flip);
+	if (j.contains("animation"))
+		t.animation = intern(j.at("animation").get<std::string>());
 }
 
 class Tiles {
 private:
 
+	/** The number of journal records after which saving compacts them into the base file. */
+	static constexpr std::size_t compact_after {4096};
+
 	// Private variables.
 
-	int cols, size;
+	int rows, cols, size;
 	std::vector<Tile> tiles;
+	/** Disk-backed storage of the whole map (or nullptr if the map is kept
+	 * in memory). In that case the tiles are a view of the map at the camera. */
+	std::unique_ptr<RegionStore> store;
+	int cam_col {0}, cam_row {0};
+	/** Journal of the changes since the last save of the whole map (or nullptr). */
+	std::unique_ptr<Journal> journal;
 	SDL_Color bg_col;
+	Animations animations;
+	/** Indices of the tiles that play an animation. */
+	std::vector<std::size_t> animated;
+	/** The first corner of a selection that is being made (in map tiles). */
+	std::optional<std::pair<int, int>> anchor;
+	/** The selected area in map tiles (empty if nothing is selected). */
+	SDL_Rect selection {0, 0, 0, 0};
+	Prefab clipboard;
+	/** The interned path of the currently selected bmp or animation. */
+	std::string_view selected;
+	std::vector<RenderData> data;
 
 	// Private methods.
 
+	/** Sets the content of a tile and keeps the set of animated tiles up to date.
+	 * @param index The index of the tile.
+	 * @param path_to_bmp The path to the bmp or the name of the animation. */
+	void set_tile(std::size_t index, std::string_view path_to_bmp) {
+		auto& tile = tiles[index];
+		bool was_animated = !tile.animation.empty();
+		bool is_animated = animations.contains(path_to_bmp);
+		if (is_animated) {
+			tile.animation = path_to_bmp;
+			tile.path_to_bmp = animations.current_frame(path_to_bmp);
+		} else {
+			tile.animation = {};
+			tile.path_to_bmp = path_to_bmp;
+		}
+		if (is_animated && !was_animated) {
+			animated.push_back(index);
+		} else if (!is_animated && was_animated) {
+			auto it = std::find(animated.begin(), animated.end(), index);
+			*it = animated.back();
+			animated.pop_back();
+		}
+	}
+
+	/** Restores the state of a tile from the base file or from the journal.
+	 * @param index The index of the tile.
+	 * @param state The angle, flip and is_set of the tile.
+	 * @param name The path to the bmp or the name of the animation. */
+	void restore_tile(std::size_t index, const Tile& state, std::string_view name) {
+		auto& tile = tiles[index];
+		tile.is_set = state.is_set && !name.empty();
+		tile.angle = state.angle;
+		tile.flip = state.flip;
+		set_tile(index, tile.is_set ? intern(name) : std::string_view{});
+	}
+
+	/** Copies the tiles of a prefab into the map. Tiles falling outside
+	 * the map are dropped.
+	 * @param col The column of the top left corner.
+	 * @param row The row of the top left corner.
+	 * @param prefab The prefab. */
+	void apply_stamp(int col, int row, const Prefab& prefab) {
+		int w = std::min(prefab.get_cols(), cols - col);
+		int h = std::min(prefab.get_rows(), rows - row);
+		for (int y = 0; y < h; y++) {
+			for (int x = 0; x < w; x++) {
+				const auto& t = prefab.at(x, y);
+				restore_tile(static_cast<std::size_t>((row + y) * cols + col + x), t, content(t));
+			}
+		}
+	}
+
+	/** Returns the position in the map of the tile under the mouse.
+	 * @param mouse_pos The current mouse position.
+	 * @return The column and the row, or nothing if no tile is under the mouse. */
+	std::optional<std::pair<int, int>> tile_at(std::pair<int, int> mouse_pos) const {
+		for (std::size_t i = 0; i < tiles.size(); i++) {
+			const auto& rect = tiles[i].rect;
+			if (
+				mouse_pos.first >= rect.x && mouse_pos.first < rect.x + rect.w &&
+				mouse_pos.second >= rect.y && mouse_pos.second < rect.y + rect.h
+			)
+				return std::make_pair(
+					cam_col + static_cast<int>(i) % cols, cam_row + static_cast<int>(i) / cols);
+		}
+		return std::nullopt;
+	}
+
+	/** Returns the name a tile can be restored from: its animation or its bmp. */
+	static std::string_view content(const Tile& tile) {
+		return tile.animation.empty() ? tile.path_to_bmp : tile.animation;
+	}
+
+	/** Moves every animated tile to the frame visible at the given time.
+	 * The tiles in the animated set are only visited when a frame boundary
+	 * has been crossed.
+	 * @param ticks The current time in milliseconds. */
+	void advance_animations(Uint32 ticks) {
+		if (!animations.tick(ticks))
+			return;
+		for (auto i : animated) {
+			tiles[i].path_to_bmp = animations.current_frame(tiles[i].animation);
+		}
+	}
+
+	/** Copies the tiles under the camera out of the region store. Tiles of
+	 * regions that have not been loaded yet are shown empty. */
+	void load_view() {
+		animated.clear();
+		for (std::size_t i = 0; i < tiles.size(); i++) {
+			auto& t = tiles[i];
+			SDL_Rect rect = t.rect;
+			const Tile* src = store->find(
+				cam_col + static_cast<int>(i) % cols, cam_row + static_cast<int>(i) / cols);
+			t = src ? *src : Tile{};
+			t.rect = rect;
+			if (!t.animation.empty() && animations.contains(t.animation)) {
+				t.path_to_bmp = animations.current_frame(t.animation);
+				animated.push_back(i);
+			}
+		}
+	}
+
+	/** Makes the region under a tile of the view resident before the tile
+	 * is edited, so the edit starts from the stored tile and not from the
+	 * empty placeholder shown while the region is loading.
+	 * @param index The index of the tile in the view. */
+	void ensure_loaded(std::size_t index) {
+		int col = cam_col + static_cast<int>(index) % cols;
+		int row = cam_row + static_cast<int>(index) / cols;
+		if (store->find(col, row))
+			return;
+		store->get(col, row);
+		load_view();
+	}
+
+	/** Writes a tile of the view back into the region store.
+	 * @param index The index of the tile in the view. */
+	void store_tile(std::size_t index) {
+		auto& dst = store->edit(
+			cam_col + static_cast<int>(index) % cols, cam_row + static_cast<int>(index) / cols);
+		dst = tiles[index];
+		dst.rect = {0, 0, 0, 0};
+		if (!dst.is_set)
+			dst.path_to_bmp = {};
+	}
+
+	/** Moves the camera over the map and requests the regions around it.
+	 * @param pan The number of tiles to move the camera by. */
+	void move_camera(std::pair<int, int> pan) {
+		cam_col = std::clamp(cam_col + pan.first, 0, store->get_map_cols() - cols);
+		cam_row = std::clamp(cam_row + pan.second, 0, store->get_map_rows() - rows);
+		store->focus({cam_col, cam_row, cols, rows});
+	}
+
 	/** Distributes the tiles based on the current panel width.
 	 * @param panel_w The current panel width. */
 	void distribute_tiles(int panel_w) {
@@ -106,14 +260,46 @@ private:
 		}
 	}
 
-	/** Saves the current map layout into a .json file.
+	/** Saves the current map layout into a .json file. The file is replaced
+	 * at once, so a crash while saving leaves the previous one intact.
 	 * @throws std::runtime_error on failure. */
 	void save() {
-		json j = tiles;
-		std::ofstream file("tiles.json"); // this should not be hardcoded!
+		std::vector<Tile> saved = tiles;
+		for (auto& t : saved) {
+			if (!t.is_set)
+				t.path_to_bmp = {};
+		}
+		json j = saved;
+		{
+			std::ofstream file("tiles.json.tmp"); // this should not be hardcoded!
+			if (!file.is_open())
+				throw std::runtime_error("Failed to save .json file");
+			file << j.dump(4);
+			if (!file)
+				throw std::runtime_error("Failed to save .json file");
+		}
+		std::filesystem::rename("tiles.json.tmp", "tiles.json");
+	}
+
+	/** Loads the map layout saved by save() if there is one.
+	 * @throws std::runtime_error on failure or if the file is damaged. */
+	void load() {
+		std::ifstream file("tiles.json");
 		if (!file.is_open())
-			throw std::runtime_error("Failed to save .json file");
-		file << j.dump(4);
+			return;
+		std::vector<Tile> saved;
+		try {
+			saved = json::parse(file).get<std::vector<Tile>>();
+		} catch (const json::exception&) {
+			throw std::runtime_error("Invalid .json file");
+		}
+		if (saved.size() != tiles.size())
+			throw std::runtime_error("Saved map does not match the map.");
+		for (std::size_t i = 0; i < saved.size(); i++) {
+			saved[i].is_set = true;
+			restore_tile(i, saved[i],
+				saved[i].animation.empty() ? saved[i].path_to_bmp : saved[i].animation);
+		}
 	}
 
 public:
@@ -122,35 +308,219 @@ public:
 	 * @param rows The numbe rof rows in the map.
 	 * @param cols The number of columns in the map.
 	 * @param bg_col The background color.
-	 * @param panel_w The current width of the panel. */
-	Tiles(int rows, int cols, int size, SDL_Color bg_col, int panel_w) :
-		cols(cols), size(size), bg_col(bg_col)
+	 * @param panel_w The current width of the panel.
+	 * @param animations The animations that can be placed into the tiles. */
+	Tiles(
+		int rows, int cols, int size, SDL_Color bg_col, int panel_w,
+		Animations animations = {}
+	) :
+		rows(rows), cols(cols), size(size), bg_col(bg_col), animations(std::move(animations))
 	{
 		for (int i = 0; i < rows * cols; i++) {
 			Tile tile;
 			tiles.push_back(tile);
 		}
 		distribute_tiles(panel_w);
+		RenderData borders;
+		borders.batch = true;
+		borders.col_or_path_to_tex = SDL_Color{0, 0, 0, 255};
+		RenderData inner_rects;
+		inner_rects.batch = true;
+		inner_rects.col_or_path_to_tex = bg_col;
+		data.push_back(borders);
+		data.push_back(inner_rects);
 	}
 
-	/** Returns the most up-to-date rendering context to be drawn. */
-	auto render_data() {
-		std::vector<RenderData> data;
+	/** Constructor for the Tiles class that keeps the map on disk.
+	 * Only the regions around the camera are kept in memory and saving
+	 * only writes the regions that were edited.
+	 * @param rows The number of rows visible at once.
+	 * @param cols The number of columns visible at once.
+	 * @param bg_col The background color.
+	 * @param panel_w The current width of the panel.
+	 * @param store The storage of the map.
+	 * @param animations The animations that can be placed into the tiles. */
+	Tiles(
+		int rows, int cols, int size, SDL_Color bg_col, int panel_w,
+		std::unique_ptr<RegionStore> store, Animations animations = {}
+	) :
+		Tiles(
+			std::min(rows, store->get_map_rows()), std::min(cols, store->get_map_cols()),
+			size, bg_col, panel_w, std::move(animations)
+		)
+	{
+		this->store = std::move(store);
+		move_camera({0, 0});
+	}
+
+	/** Constructor for the Tiles class that journals every change.
+	 * The map saved last is loaded and the journal is replayed over it,
+	 * so the session continues where it ended, even after a crash.
+	 * Saving then only makes the new records durable, and compacts them
+	 * into the saved map once there are many of them.
+	 * @param rows The number of rows in the map.
+	 * @param cols The number of columns in the map.
+	 * @param bg_col The background color.
+	 * @param panel_w The current width of the panel.
+	 * @param journal The journal of the map.
+	 * @param animations The animations that can be placed into the tiles.
+	 * @throws std::runtime_error on failure. */
+	Tiles(
+		int rows, int cols, int size, SDL_Color bg_col, int panel_w,
+		std::unique_ptr<Journal> journal, Animations animations = {}
+	) :
+		Tiles(rows, cols, size, bg_col, panel_w, std::move(animations))
+	{
+		load();
+		[[maybe_unused]] auto replayed = journal->replay(
+			[&](Uint32 index, const Tile& state, std::string_view name){
+				restore_tile(index, state, name);
+			},
+			[&](Uint32 index, const Prefab& prefab){
+				apply_stamp(static_cast<int>(index) % cols, static_cast<int>(index) / cols, prefab);
+			});
+		this->journal = std::move(journal);
+		DBGMSG("Journal records replayed: " << replayed);
+	}
+
+	/** Compacts the journal into the base file on a clean shutdown, so the
+	 * next session does not have to replay the records of this one. */
+	~Tiles() {
+		if (!journal || !journal->get_count())
+			return;
+		try {
+			save();
+			journal->reset();
+			DBGMSG("Journal compacted.");
+		} catch (const std::runtime_error&) {
+			// The journal is still intact and is replayed next time.
+		}
+	}
+
+	Tiles(Tiles&&) = default;
+	Tiles& operator=(Tiles&&) = default;
+
+	/** Marks a corner of the selection at the tile under the mouse. The first
+	 * call selects that tile, the second one extends the selection to the
+	 * tile under the mouse. Clicking outside the map clears the selection.
+	 * @param mouse_pos The current mouse position. */
+	void select(std::pair<int, int> mouse_pos) {
+		auto pos = tile_at(mouse_pos);
+		if (!pos.has_value()) {
+			anchor.reset();
+			selection = {0, 0, 0, 0};
+			return;
+		}
+		if (!anchor.has_value()) {
+			anchor = pos;
+			selection = {pos->first, pos->second, 1, 1};
+			return;
+		}
+		selection.x = std::min(anchor->first, pos->first);
+		selection.y = std::min(anchor->second, pos->second);
+		selection.w = std::abs(anchor->first - pos->first) + 1;
+		selection.h = std::abs(anchor->second - pos->second) + 1;
+		anchor.reset();
+	}
+
+	/** Copies the selected tiles into the clipboard. On a map kept on disk
+	 * the regions that are not resident are read without becoming resident.
+	 * @throws std::runtime_error on failure. */
+	void copy() {
+		if (selection.w == 0)
+			return;
+		std::vector<Tile> block(static_cast<std::size_t>(selection.w * selection.h));
+		auto at = [&](int col, int row) -> Tile& {
+			return block[static_cast<std::size_t>((row - selection.y) * selection.w + col - selection.x)];
+		};
+		if (store) {
+			store->for_each_in(selection, [&](int col, int row, const Tile& t){ at(col, row) = t; });
+		} else {
+			for (int row = selection.y; row < selection.y + selection.h; row++) {
+				for (int col = selection.x; col < selection.x + selection.w; col++)
+					at(col, row) = tiles[static_cast<std::size_t>(row * cols + col)];
+			}
+		}
+		for (auto& t : block) {
+			t.rect = {0, 0, 0, 0};
+			if (!t.is_set)
+				t.path_to_bmp = {};
+		}
+		clipboard = Prefab(selection.w, selection.h, std::move(block));
+	}
+
+	/** Stamps the clipboard onto the map with its top left corner at the
+	 * tile under the mouse. Tiles falling outside the map are dropped. A map
+	 * kept on disk only records a reference to the clipboard, and a
+	 * journaled map appends a single record.
+	 * @param mouse_pos The current mouse position.
+	 * @throws std::runtime_error on failure. */
+	void stamp(std::pair<int, int> mouse_pos) {
+		auto pos = tile_at(mouse_pos);
+		if (!pos.has_value() || clipboard.empty())
+			return;
+		if (store) {
+			store->stamp(pos->first, pos->second, clipboard);
+			load_view();
+			return;
+		}
+		apply_stamp(pos->first, pos->second, clipboard);
+		if (journal)
+			journal->append_stamp(static_cast<Uint32>(pos->second * cols + pos->first), clipboard);
+	}
+
+	/** Returns the clipboard. */
+	const Prefab& get_clipboard() const {
+		return clipboard;
+	}
+
+	/** Replaces the clipboard (e.g. with a prefab). The tiles are shared, not copied.
+	 * @param prefab The new contents of the clipboard. */
+	void set_clipboard(const Prefab& prefab) {
+		clipboard = prefab;
+	}
+
+	/** Returns the most up-to-date rendering context to be drawn.
+	 * The borders and the backgrounds of the empty tiles are batched into
+	 * one rendering context each, so an empty map costs two draw calls
+	 * regardless of its size. The returned vector is reused by the next call,
+	 * so building it does not allocate once its capacity has been reached. */
+	const std::vector<RenderData>& render_data() {
+		data.resize(2);
+		data[0].dstrects.clear();
+		data[1].dstrects.clear();
 		for (const auto& t : tiles) {
-			RenderData tile;
-			tile.dstrect = t.rect;
 			if (!t.path_to_bmp.empty()) {
+				RenderData tile;
+				tile.dstrect = t.rect;
 				tile.col_or_path_to_tex = t.path_to_bmp;
 				tile.angle = t.angle;
 				tile.flip = t.flip;
 				data.push_back(tile);
 			} else {
-				tile.col_or_path_to_tex = SDL_Color{0, 0, 0, 255};
-				RenderData inner_rect;
-				inner_rect.dstrect = {t.rect.x + 1, t.rect.y + 1, t.rect.w - 2, t.rect.h - 2};
-				inner_rect.col_or_path_to_tex = bg_col;
-				data.push_back(tile);
-				data.push_back(inner_rect);
+				// Indexed on purpose: pushing textured tiles may reallocate data.
+				data[0].dstrects.push_back(t.rect);
+				data[1].dstrects.push_back({t.rect.x + 1, t.rect.y + 1, t.rect.w - 2, t.rect.h - 2});
+			}
+		}
+		// The outline of the visible part of the selection.
+		int x0 = std::max(selection.x, cam_col), x1 = std::min(selection.x + selection.w, cam_col + cols);
+		int y0 = std::max(selection.y, cam_row), y1 = std::min(selection.y + selection.h, cam_row + rows);
+		if (selection.w > 0 && x0 < x1 && y0 < y1) {
+			const auto& origin = tiles.front().rect;
+			SDL_Rect area {
+				origin.x + (x0 - cam_col) * size, origin.y + (y0 - cam_row) * size,
+				(x1 - x0) * size, (y1 - y0) * size
+			};
+			const SDL_Rect edges[4] {
+				{area.x, area.y, area.w, 2}, {area.x, area.y + area.h - 2, area.w, 2},
+				{area.x, area.y, 2, area.h}, {area.x + area.w - 2, area.y, 2, area.h}
+			};
+			for (const auto& edge : edges) {
+				RenderData outline;
+				outline.dstrect = edge;
+				outline.col_or_path_to_tex = SDL_Color{255, 220, 0, 255};
+				data.push_back(outline);
 			}
 		}
 		return data;
@@ -159,29 +529,50 @@ public:
 	/** Updates all the tiles based on window size, panel width and user input.
 	 * @param mouse_pos The current mouse position.
 	 * @param left_click The current state of the left mouse button.
-	 * @param path_to_bmp The path to the currently selected bmp.
+	 * @param path_to_bmp The path to the currently selected bmp or animation.
 	 * @param panel_w The current panel width.
 	 * @param f_key The current state of the f key.
 	 * @param r_key The current state of the r key.
-	 * @param s_key The current state of the s key. */
+	 * @param s_key The current state of the s key.
+	 * @param ticks The current time in milliseconds.
+	 * @param pan The number of tiles to move the camera by (if the map is kept on disk). */
 	void update(
 		std::pair<int, int> mouse_pos,
-		bool left_click, std::string path_to_bmp,
+		bool left_click, std::string_view path_to_bmp,
 		int panel_w,
-		bool f_key, bool r_key, bool s_key
+		bool f_key, bool r_key, bool s_key,
+		Uint32 ticks,
+		std::pair<int, int> pan = {0, 0}
 	) {
 
+		if (store) {
+			bool moved = pan.first || pan.second;
+			if (moved)
+				move_camera(pan);
+			if (store->poll() || moved)
+				load_view();
+		}
+
 		distribute_tiles(panel_w);
+		advance_animations(ticks);
 
-		for (auto& tile : tiles) {
+		if (path_to_bmp != selected)
+			selected = intern(path_to_bmp);
+		std::string_view preview = animations.contains(selected) ?
+			animations.current_frame(selected) : selected;
+
+		for (std::size_t i = 0; i < tiles.size(); i++) {
+			auto& tile = tiles[i];
 			if (
 				mouse_pos.first >= tile.rect.x &&
 				mouse_pos.first <= tile.rect.x + tile.rect.w &&
 				mouse_pos.second >= tile.rect.y &&
 				mouse_pos.second <= tile.rect.y + tile.rect.h
 		    ) {
+				if (store && (r_key || f_key || left_click))
+					ensure_loaded(i);
 				if (!tile.is_set)
-					tile.path_to_bmp = path_to_bmp;
+					tile.path_to_bmp = preview;
 				if (r_key)
 					tile.angle += 90.0f;
 				if (f_key) {
@@ -195,16 +586,30 @@ public:
 				}
 				if (left_click) {
 					tile.is_set = true;
-					tile.path_to_bmp = path_to_bmp;
+					set_tile(i, selected);
 				}
+				if (store && (r_key || f_key || left_click))
+					store_tile(i);
+				if (journal && (r_key || f_key || left_click))
+					journal->append(static_cast<Uint32>(i), tile);
 			} else {
 				if (!tile.is_set)
-					tile.path_to_bmp.clear();
+					tile.path_to_bmp = {};
 			}
 		}
 
 		if (s_key) {
-			save();
+			if (store) {
+				store->flush();
+			} else if (journal) {
+				journal->sync();
+				if (journal->get_count() >= compact_after) {
+					save();
+					journal->reset();
+				}
+			} else {
+				save();
+			}
 		}
 	}
 
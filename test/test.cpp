@@ -1,10 +1,27 @@
 #include <ctest.h>
+#include <chrono>
+#include <filesystem>
 #include <iostream>
 #include <stdexcept>
+#include <thread>
 #include "core.hpp"
+#include "alloc_tracker.hpp"
+#include "animation.hpp"
 #include "browser.hpp"
+#include "compositor.hpp"
+#include "editor.hpp"
+#include "journal.hpp"
+#include "lockfree.hpp"
+#include "pack.hpp"
+#include "prefab.hpp"
+#include "regions.hpp"
+#include "search.hpp"
 #include "tiles.hpp"
 
+#ifndef TEST_ASSETS
+#define TEST_ASSETS "test/assets"
+#endif
+
 using namespace Core;
 
 int main(void) {
@@ -27,9 +44,9 @@ int main(void) {
 
 		browser.update(sdl.win_size(), 0, sdl.get_mouse_pos(), sdl.get_left_click());
 
-		Tiles tiles(4, 4, 64, {30, 70, 70, 255}, browser.get_panel_w());
+		Tiles tiles(4, 4, 64, {30, 70, 70, 255}, browser.get_panel_w(), browser.get_animations());
 
-		tiles.update(sdl.get_mouse_pos(), sdl.get_left_click(), "", browser.get_panel_w(), sdl.get_f_key(), sdl.get_r_key(), sdl.get_s_key());
+		tiles.update(sdl.get_mouse_pos(), sdl.get_left_click(), "", browser.get_panel_w(), sdl.get_f_key(), sdl.get_r_key(), sdl.get_s_key(), SDL_GetTicks());
 
 		sdl.draw(tiles.render_data());
 
@@ -37,6 +54,372 @@ int main(void) {
 
 		CTEST(1);
 
+		Animations animations;
+		animations.add("torch", {{"a.bmp", "b.bmp", "c.bmp"}, {100, 50, 100}});
+		CTEST(!animations.tick(0));
+		CTEST(animations.current_frame("torch") == "a.bmp");
+		CTEST(animations.tick(120));
+		CTEST(animations.current_frame("torch") == "b.bmp");
+		CTEST(!animations.tick(149));
+		animations.tick(150);
+		CTEST(animations.current_frame("torch") == "c.bmp");
+		animations.tick(260);
+		CTEST(animations.current_frame("torch") == "a.bmp");
+
+		{
+			// An empty map fills its borders and backgrounds with one call each,
+			// a full one only copies textures.
+			int panel_w = browser.get_panel_w();
+			Tiles map(4, 4, 64, {30, 70, 70, 255}, panel_w);
+			sdl.reset_draw_stats();
+			sdl.draw(map.render_data());
+			CTEST(sdl.get_draw_stats().fill_calls == 2);
+			CTEST(sdl.get_draw_stats().filled_rects == 2 * 16);
+			CTEST(sdl.get_draw_stats().copies == 0);
+			std::string_view bmp = intern(browser.get_paths_to_bmps().front());
+			for (int row = 0; row < 4; row++) {
+				for (int col = 0; col < 4; col++)
+					map.update({panel_w + 10 + col * 64, 10 + row * 64}, true, bmp, panel_w, false, false, false, 0);
+			}
+			sdl.reset_draw_stats();
+			sdl.draw(map.render_data());
+			CTEST(sdl.get_draw_stats().fill_calls == 0);
+			CTEST(sdl.get_draw_stats().copies == 16);
+		}
+
+		// The trailing separator must not change the names or turn the bmps into an animation.
+		Pack::build(TEST_ASSETS "/", "test.pack");
+		{
+			Pack pack("test.pack");
+			Browser dir_browser(sdl.win_size(), 0.1f, {100, 100, 100, 255}, TEST_ASSETS);
+			CTEST(pack.get_root() == Pack::normalize_root(TEST_ASSETS).string());
+			CTEST(pack.entries().size() == dir_browser.get_paths_to_bmps().size());
+			Browser pack_browser(sdl.win_size(), 0.1f, {100, 100, 100, 255}, pack);
+			CTEST(pack_browser.get_paths_to_bmps() == dir_browser.get_paths_to_bmps());
+			CTEST(!pack_browser.get_animations().contains(pack.get_root()));
+			for (const auto& e : pack.entries()) {
+				auto sur = pack.surface(e);
+				CTEST(sur->pixels == e.pixels);
+				sdl.load_texture(e.name, sur.get());
+			}
+		}
+		std::filesystem::remove("test.pack");
+
+		// Idle hover/scroll frames must not allocate once warmed up.
+		auto win_size = sdl.win_size();
+		auto frame = [&](std::pair<int, int> mouse_pos, int scroll_state) {
+			browser.update(win_size, scroll_state, mouse_pos, false);
+			tiles.update(mouse_pos, false, browser.get_selected_bmp(), browser.get_panel_w(), false, false, false, SDL_GetTicks());
+			sdl.draw(browser.render_data());
+			sdl.draw(tiles.render_data());
+		};
+		for (int pass = 0; pass < 2; pass++) {
+			AllocTracker::reset();
+			for (int x = 0; x < win_size.first; x += 8)
+				frame({x, x % win_size.second}, x % 3 - 1);
+		}
+		CTEST(AllocTracker::total() == 0);
+
+		SearchIndex index({"/walls/brick_wall.bmp", "/walls/stone-wall.bmp", "/floor.bmp", "/torch"});
+		CTEST(index.get_results().size() == 4);
+		index.search("wa");
+		CTEST((index.get_results() == std::vector<std::size_t>{0, 1}));
+		index.search("wall st");
+		CTEST((index.get_results() == std::vector<std::size_t>{1}));
+		index.search("TORCH");
+		CTEST((index.get_results() == std::vector<std::size_t>{3}));
+		index.search("");
+		CTEST(index.get_results().size() == 4);
+
+		browser.search("wall");
+		browser.update(win_size, 0, {0, 0}, false);
+		CTEST(browser.render_data().size() == 2);
+		browser.search("");
+
+		std::filesystem::remove_all("test_map");
+
+		{
+			RegionStore store("test_map", 1000, 1000, 16, 4);
+			for (auto [col, row] : {std::make_pair(500, 700), std::make_pair(0, 0)}) {
+				auto& t = store.edit(col, row);
+				t.is_set = true;
+				t.path_to_bmp = intern("wall.bmp");
+				t.angle = 90.0f;
+			}
+			store.flush();
+		}
+		{
+			RegionStore store("test_map", 1000, 1000, 16, 4);
+			auto wait_for = [&](int col, int row) {
+				for (int i = 0; i < 1000 && !store.find(col, row); i++) {
+					store.poll();
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+				return store.find(col, row);
+			};
+			CTEST(store.find(500, 700) == nullptr);
+			store.focus({490, 690, 12, 10});
+			const Tile* t = wait_for(500, 700);
+			CTEST(t && t->is_set && t->path_to_bmp == "wall.bmp" && t->angle == 90.0f);
+			store.focus({0, 0, 12, 10});
+			wait_for(0, 0);
+			store.focus({0, 0, 12, 10});
+			CTEST(store.get_resident_count() <= 4);
+		}
+		{
+			bool mismatch = false;
+			try {
+				RegionStore other("test_map", 1000, 1000, 32, 4);
+			} catch (const std::runtime_error&) {
+				mismatch = true;
+			}
+			CTEST(mismatch);
+		}
+		{
+			// A background load that finishes after its region was loaded,
+			// edited and evicted must not bring back the old tiles.
+			{
+				RegionStore store("test_race", 64, 16, 16, 1);
+				store.focus({0, 0, 16, 16});
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				auto& t = store.edit(0, 0);
+				t.is_set = true;
+				t.path_to_bmp = intern("wall.bmp");
+				store.edit(16, 0);
+				store.focus({48, 0, 16, 16});
+				CTEST(!store.find(0, 0));
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				store.poll();
+				store.edit(1, 0);
+			}
+			RegionStore store("test_race", 64, 16, 16, 1);
+			CTEST(store.get(0, 0).is_set && store.get(0, 0).path_to_bmp == "wall.bmp");
+		}
+		std::filesystem::remove_all("test_race");
+		{
+			// Rotating a tile whose region is still loading keeps the stored tile.
+			int panel_w = browser.get_panel_w();
+			Tiles paged(4, 4, 64, {30, 70, 70, 255}, panel_w,
+				std::make_unique<RegionStore>("test_map", 1000, 1000, 16, 4));
+			paged.update({panel_w + 10, 10}, false, "a.bmp", panel_w, false, true, false, 0);
+			paged.update({panel_w + 10, 10}, false, "a.bmp", panel_w, false, false, false, 0);
+			const auto& data = paged.render_data();
+			CTEST(data.size() == 3 && data[2].angle == 180.0f &&
+				std::get<std::string_view>(data[2].col_or_path_to_tex) == "wall.bmp");
+		}
+		std::filesystem::remove_all("test_map");
+
+		{
+			// Stamps refer to one shared block; only edited tiles are copied.
+			Tile wall, floor;
+			wall.is_set = floor.is_set = true;
+			wall.path_to_bmp = intern("wall.bmp");
+			floor.path_to_bmp = intern("floor.bmp");
+			Prefab room(2, 2, {wall, Tile{}, Tile{}, floor});
+			{
+				RegionStore store("test_stamps", 1000, 1000, 16, 4);
+				for (int i = 0; i < 1000; i += 2)
+					store.stamp(i, i, room);
+				CTEST(store.get_resident_count() == 0 && store.get_dirty_count() == 0);
+				int seen = 0;
+				store.for_each_in({-1, -1, 3, 3}, [&](int col, int row, const Tile& t){
+					seen += &t == &room.at(col, row);
+				});
+				CTEST(seen == 4 && store.get_resident_count() == 0);
+				store.get(0, 0);
+				CTEST(store.find(0, 0) == &room.at(0, 0) && store.find(3, 3) == &room.at(1, 1));
+				store.edit(1, 1).angle = 90.0f;
+				const Tile* edited = store.find(1, 1);
+				CTEST(edited != &room.at(1, 1) && edited->angle == 90.0f && edited->path_to_bmp == "floor.bmp");
+				CTEST(room.at(1, 1).angle == 0.0f && store.find(3, 3) == &room.at(1, 1));
+				CTEST(store.get_dirty_count() == 1);
+			}
+			RegionStore store("test_stamps", 1000, 1000, 16, 4);
+			CTEST(store.get(1, 1).angle == 90.0f && store.get(1, 1).path_to_bmp == "floor.bmp");
+			CTEST(store.get(998, 998).path_to_bmp == "wall.bmp" && !store.get(999, 998).is_set);
+			CTEST(store.find(2, 2) == store.find(998, 998));
+			int set = 0;
+			store.for_each_tile([&](int, int, const Tile&){ set++; });
+			CTEST(set == 1000);
+			auto blocks = std::filesystem::directory_iterator("test_stamps/blocks");
+			CTEST(std::distance(std::filesystem::begin(blocks), std::filesystem::end(blocks)) == 1);
+		}
+		std::filesystem::remove_all("test_stamps");
+
+		{
+			std::vector<Uint32> src(37), dst(37), expected;
+			for (std::size_t i = 0; i < src.size(); i++) {
+				src[i] = static_cast<Uint32>(i * 2654435761u);
+				dst[i] = static_cast<Uint32>(i * 40503u + 12345u);
+			}
+			expected = dst;
+			Compositor::blend_row_scalar(expected.data(), src.data(), src.size());
+			Compositor::blend_row(dst.data(), src.data(), src.size());
+			CTEST(dst == expected);
+
+			// A 2x1 image: red on the left, blue on the right.
+			Surface sur(SDL_CreateRGBSurfaceWithFormat(0, 2, 1, 32, SDL_PIXELFORMAT_ARGB8888), SDL_FreeSurface);
+			static_cast<Uint32*>(sur->pixels)[0] = 0xffff0000u;
+			static_cast<Uint32*>(sur->pixels)[1] = 0xff0000ffu;
+			Compositor compositor(2, 2, 2, {0, 255, 0, 255});
+			compositor.add_image("rb.bmp", sur.get());
+			Tile tile;
+			tile.path_to_bmp = intern("rb.bmp");
+			compositor.place(0, 0, tile);
+			tile.angle = 180.0f;
+			compositor.place(1, 1, tile);
+			compositor.save("test_map.bmp", 2);
+			std::ifstream file("test_map.bmp", std::ios::binary);
+			std::vector<char> bytes((std::istreambuf_iterator<char>(file)), {});
+			CTEST(bytes.size() == 54 + 4 * 4 * 4);
+			auto px = [&](int x, int y) {
+				Uint32 p;
+				std::memcpy(&p, bytes.data() + 54 + (y * 4 + x) * 4, 4);
+				return p;
+			};
+			CTEST(px(0, 0) == 0xffff0000u && px(1, 0) == 0xff0000ffu);
+			CTEST(px(2, 0) == 0xff00ff00u && px(0, 3) == 0xff00ff00u);
+			CTEST(px(2, 3) == 0xff0000ffu && px(3, 3) == 0xffff0000u);
+		}
+		std::filesystem::remove("test_map.bmp");
+
+		std::filesystem::remove("tiles.json");
+		std::filesystem::remove("tiles.journal");
+
+		{
+			int panel_w = browser.get_panel_w();
+			auto at = [&](int col, int row) { return std::make_pair(panel_w + 10 + col * 64, 10 + row * 64); };
+			Tiles map(4, 4, 64, {30, 70, 70, 255}, panel_w);
+			map.update(at(0, 0), true, "a.bmp", panel_w, false, false, false, 0);
+			map.select(at(0, 0));
+			map.select(at(1, 1));
+			map.copy();
+			CTEST(map.get_clipboard().get_cols() == 2 && map.get_clipboard().get_rows() == 2);
+			map.stamp(at(2, 2));
+			map.stamp(at(3, 0));
+			// Three set tiles, the borders, the backgrounds and the selection outline.
+			CTEST(map.render_data().size() == 2 + 3 + 4);
+			{
+				Prefabs prefabs("test_prefabs");
+				prefabs.save("1", map.get_clipboard());
+				CTEST(prefabs.find("1") && prefabs.find("1")->shares(map.get_clipboard()));
+			}
+			Prefabs reloaded("test_prefabs");
+			const Prefab* room = reloaded.find("1");
+			CTEST(room && room->get_cols() == 2 && room->at(0, 0).path_to_bmp == "a.bmp" && !room->at(1, 1).is_set);
+			CTEST(!reloaded.find("2"));
+			// A corrupt file, here one whose dimensions overflow when multiplied.
+			{
+				std::ofstream file("test_prefabs/2.prefab", std::ios::binary);
+				Uint32 side = 0x10000u;
+				file.write("SDLPFB1", 8);
+				file.write(reinterpret_cast<const char*>(&side), sizeof(side));
+				file.write(reinterpret_cast<const char*>(&side), sizeof(side));
+			}
+			Prefabs skipped("test_prefabs");
+			CTEST(skipped.find("1") && !skipped.find("2"));
+		}
+		std::filesystem::remove_all("test_prefabs");
+		{
+			int panel_w = browser.get_panel_w();
+			{
+				Tiles journaled(4, 4, 64, {30, 70, 70, 255}, panel_w,
+					std::make_unique<Journal>("tiles.journal", 16));
+				journaled.update({panel_w + 10, 10}, true, "a.bmp", panel_w, false, false, false, 0);
+				journaled.update({panel_w + 10, 10}, false, "a.bmp", panel_w, false, true, true, 0);
+				CTEST(!std::filesystem::exists("tiles.json"));
+			}
+			// A clean shutdown compacts the journal into the base file.
+			CTEST(std::filesystem::exists("tiles.json"));
+			CTEST(Journal("tiles.journal", 16).replay(
+				[](Uint32, const Tile&, std::string_view){}, [](Uint32, const Prefab&){}) == 0);
+			std::filesystem::remove("tiles.json");
+			{
+				// A crashed session leaves its records behind, the last one torn.
+				Journal crashed("tiles.journal", 16);
+				Tile tile;
+				tile.is_set = true;
+				tile.path_to_bmp = intern("a.bmp");
+				crashed.append(0, tile);
+				tile.angle = 90.0f;
+				crashed.append(0, tile);
+				// A stamp is one record; the part outside the map is dropped.
+				crashed.append_stamp(15, Prefab(2, 2, {tile, Tile{}, Tile{}, Tile{}}));
+				CTEST(crashed.get_count() == 3);
+			}
+			std::ofstream("tiles.journal", std::ios::binary | std::ios::app) << "torn";
+			Tiles recovered(4, 4, 64, {30, 70, 70, 255}, panel_w,
+				std::make_unique<Journal>("tiles.journal", 16));
+			const auto& data = recovered.render_data();
+			CTEST(data.size() == 4);
+			CTEST(data.size() == 4 && data[2].angle == 90.0f &&
+				std::get<std::string_view>(data[2].col_or_path_to_tex) == "a.bmp");
+			CTEST(data.size() == 4 && data[3].angle == 90.0f &&
+				std::get<std::string_view>(data[3].col_or_path_to_tex) == "a.bmp");
+			bool mismatch = false;
+			try {
+				Journal other("tiles.journal", 9);
+			} catch (const std::runtime_error&) {
+				mismatch = true;
+			}
+			CTEST(mismatch);
+		}
+		{
+			// A damaged base file is reported instead of terminating.
+			std::ofstream("tiles.json") << "[{\"rect\":";
+			bool damaged = false;
+			try {
+				Tiles broken(4, 4, 64, {30, 70, 70, 255}, browser.get_panel_w(),
+					std::make_unique<Journal>("tiles.journal", 16));
+			} catch (const std::runtime_error&) {
+				damaged = true;
+			}
+			CTEST(damaged);
+		}
+		std::filesystem::remove("tiles.json");
+		std::filesystem::remove("tiles.journal");
+
+		TripleBuffer<int> buffer;
+		CTEST(!buffer.acquire());
+		buffer.back_buffer() = 1;
+		buffer.publish();
+		buffer.back_buffer() = 2;
+		buffer.publish();
+		CTEST(buffer.acquire());
+		CTEST(buffer.front_buffer() == 2);
+		CTEST(!buffer.acquire());
+
+		{
+			Prefabs prefabs("test_prefabs");
+			Editor editor(browser, tiles, prefabs);
+			CTEST(editor.snapshot().tiles.size() == tiles.render_data().size());
+			auto push = [&](const Editor::Input& input) {
+				auto n = editor.get_published();
+				editor.push(input);
+				for (long i = 0; i < 100000000 && editor.get_published() == n; i++)
+					std::this_thread::yield();
+				return editor.snapshot().browser.size();
+			};
+			Editor::Input input;
+			input.win_size = win_size;
+			std::size_t shown = push(input);
+			// A query matching nothing leaves only the panel.
+			std::string_view("zzzz").copy(input.search_query.data(), 4);
+			CTEST(push(input) < shown);
+			input.search_query = {};
+			CTEST(push(input) == shown);
+
+			// Warmed-up frames through the editor thread must not allocate either.
+			for (int pass = 0; pass < 2; pass++) {
+				AllocTracker::reset();
+				for (int x = 0; x < win_size.first; x += 8) {
+					input.mouse_pos = {x, x % win_size.second};
+					push(input);
+				}
+			}
+			CTEST(AllocTracker::total() == 0);
+		}
+
 	} catch (const std::runtime_error& e) {
 
 		CTEST(0);